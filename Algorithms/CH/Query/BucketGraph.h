@@ -0,0 +1,223 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "CHQuery.h"
+
+#include "../CH.h"
+
+#include "../../../Helpers/Console/Progress.h"
+#include "../../../Helpers/FileSystem/FileSystem.h"
+#include "../../../Helpers/IO/Serialization.h"
+#include "../../../Helpers/MultiThreading.h"
+#include "../../../Helpers/Timer.h"
+
+namespace CH {
+
+// The bucket graphs used by a Bucket-CH query. For every POI, the forward (backward) bucket graph contains
+// an edge from every vertex in the backward (forward) upward search space of the POI to the POI itself.
+// The bucket graphs only depend on the CH and the POIs, so they can be stored next to the CH files and
+// shared read-only by all queries. Stored bucket graphs carry a checksum of the CH topology, the CH weights
+// and the POIs, such that bucket graphs of a different CH are never reused.
+class BucketGraph {
+
+private:
+    struct BucketEdge {
+        BucketEdge(const Vertex bucket = noVertex, const Vertex poi = noVertex, const int weight = INFTY) :
+            bucket(bucket),
+            poi(poi),
+            weight(weight) {
+        }
+
+        inline bool operator<(const BucketEdge& other) const noexcept {
+            return std::tie(bucket, weight, poi) < std::tie(other.bucket, other.weight, other.poi);
+        }
+
+        Vertex bucket;
+        Vertex poi;
+        int weight;
+    };
+
+public:
+    BucketGraph() :
+        endOfPOIs(0),
+        numberOfCHEdges(0),
+        checksum(0) {
+    }
+
+    BucketGraph(const std::string& fileName, const std::string& separator = ".") :
+        BucketGraph() {
+        readBinary(fileName, separator);
+    }
+
+    // Loads the bucket graphs stored next to the CH file (see buildBucketGraph). If there are none or they
+    // belong to a different CH or set of POIs, they are built with the given threads. The built bucket graphs
+    // are not stored, writing them is left to the caller.
+    inline static std::shared_ptr<const BucketGraph> FromCH(const CH& ch, const std::string& chFileName, const Vertex::ValueType endOfPOIs, const ThreadPinning& threadPinning = ThreadPinning(1, 1), const bool verbose = true) noexcept {
+        std::shared_ptr<BucketGraph> result = std::make_shared<BucketGraph>();
+        const std::string fileName = chFileName + ".bucket";
+        if (FileSystem::isFile(fileName + ".info")) {
+            result->readBinary(fileName);
+            if (result->matches(ch, endOfPOIs)) return result;
+            if (verbose) std::cout << "Bucket graphs in " << fileName << " do not match the CH, rebuilding them." << std::endl;
+        }
+        result->build(ch.forward, ch.backward, ch.forward[Weight], ch.backward[Weight], endOfPOIs, threadPinning, verbose);
+        return result;
+    }
+
+    // FNV-1a hash of the number of POIs, the topology and the weights of both CH graphs.
+    template<typename GRAPH>
+    inline static u_int64_t computeChecksum(const GRAPH& forward, const GRAPH& backward, const std::vector<int>& forwardWeight, const std::vector<int>& backwardWeight, const Vertex::ValueType numberOfPOIs) noexcept {
+        u_int64_t hash = 14695981039346656037ull;
+        const auto add = [&](const u_int64_t value) {
+            for (size_t i = 0; i < sizeof(value); i++) {
+                hash ^= (value >> (8 * i)) & 0xFF;
+                hash *= 1099511628211ull;
+            }
+        };
+        const auto addGraph = [&](const GRAPH& graph, const std::vector<int>& weight) {
+            for (const Vertex vertex : graph.vertices()) {
+                add(graph.outDegree(vertex));
+                for (const Edge edge : graph.edgesFrom(vertex)) {
+                    add(graph.get(ToVertex, edge));
+                    add(u_int32_t(weight[edge]));
+                }
+            }
+        };
+        add(numberOfPOIs);
+        add(forward.numVertices());
+        addGraph(forward, forwardWeight);
+        addGraph(backward, backwardWeight);
+        return hash;
+    }
+
+    template<bool STALL_ON_DEMAND = true, typename GRAPH>
+    inline void build(const GRAPH& forward, const GRAPH& backward, const std::vector<int>& forwardWeight, const std::vector<int>& backwardWeight, const Vertex::ValueType numberOfPOIs, const ThreadPinning& threadPinning = ThreadPinning(1, 1), const bool verbose = false) noexcept {
+        endOfPOIs = Vertex(numberOfPOIs);
+        numberOfCHEdges = forward.numEdges() + backward.numEdges();
+        checksum = computeChecksum(forward, backward, forwardWeight, backwardWeight, numberOfPOIs);
+        Timer timer;
+        buildBucketGraph<FORWARD, BACKWARD, STALL_ON_DEMAND>(forward, backward, forwardWeight, backwardWeight, threadPinning, verbose);
+        buildBucketGraph<BACKWARD, FORWARD, STALL_ON_DEMAND>(forward, backward, forwardWeight, backwardWeight, threadPinning, verbose);
+        if (verbose) std::cout << "Built bucket graphs with " << String::prettyInt(numEdges()) << " edges in " << String::msToString(timer.elapsedMilliseconds()) << std::endl;
+    }
+
+    inline const CHGraph& getGraph(const int direction) const noexcept {
+        return graph[direction];
+    }
+
+    inline Vertex getEndOfPOIs() const noexcept {
+        return endOfPOIs;
+    }
+
+    inline size_t numVertices() const noexcept {
+        return graph[FORWARD].numVertices();
+    }
+
+    inline size_t numEdges() const noexcept {
+        return graph[FORWARD].numEdges() + graph[BACKWARD].numEdges();
+    }
+
+    inline bool matches(const CH& ch, const Vertex::ValueType numberOfPOIs) const noexcept {
+        if ((numVertices() != ch.numVertices()) || (numberOfCHEdges != ch.numEdges()) || (endOfPOIs != numberOfPOIs)) return false;
+        return checksum == computeChecksum(ch.forward, ch.backward, ch.forward[Weight], ch.backward[Weight], numberOfPOIs);
+    }
+
+    inline void writeBinary(const std::string& fileName, const std::string& separator = ".") const noexcept {
+        graph[FORWARD].writeBinary(fileName + separator + "forward", separator);
+        graph[BACKWARD].writeBinary(fileName + separator + "backward", separator);
+        IO::serialize(fileName + separator + "info", size_t(endOfPOIs), numberOfCHEdges, checksum);
+    }
+
+    inline void readBinary(const std::string& fileName, const std::string& separator = ".") noexcept {
+        graph[FORWARD].readBinary(fileName + separator + "forward", separator);
+        graph[BACKWARD].readBinary(fileName + separator + "backward", separator);
+        size_t numberOfPOIs = 0;
+        checksum = 0; // Files written without a checksum never match
+        IO::deserialize(fileName + separator + "info", numberOfPOIs, numberOfCHEdges, checksum);
+        endOfPOIs = Vertex(numberOfPOIs);
+    }
+
+private:
+    // Every thread runs its own upward searches and collects the resulting bucket entries. Sorting the
+    // merged entries yields the same bucket graph as a sequential construction.
+    template<int I, int J, bool STALL_ON_DEMAND, typename GRAPH>
+    inline void buildBucketGraph(const GRAPH& forward, const GRAPH& backward, const std::vector<int>& forwardWeight, const std::vector<int>& backwardWeight, const ThreadPinning& threadPinning, const bool verbose) noexcept {
+        if (verbose) std::cout << "Building " << ((I == FORWARD) ? ("forward") : ("backward")) << " bucket graph with " << threadPinning.numberOfThreads << " threads" << std::endl;
+        std::vector<std::vector<BucketEdge>> edgesOfThread(threadPinning.numberOfThreads);
+        Progress progress(endOfPOIs, verbose);
+        omp_set_num_threads(threadPinning.numberOfThreads);
+        #pragma omp parallel
+        {
+            threadPinning.pinThread();
+
+            Query<GRAPH, STALL_ON_DEMAND, false, true> query(forward, backward, forwardWeight, backwardWeight, forward.numVertices());
+            std::vector<BucketEdge>& edges = edgesOfThread[omp_get_thread_num()];
+
+            #pragma omp for schedule(dynamic, 64)
+            for (size_t i = 0; i < endOfPOIs; i++) {
+                const Vertex poi(i);
+                query.template run<J, I>(poi);
+                for (const Vertex bucket : query.template getPOIs<J>()) {
+                    edges.emplace_back(bucket, poi, query.template getDistanceToPOI<J>(bucket));
+                }
+                progress++;
+            }
+        }
+        progress.finished();
+
+        size_t numberOfEdges = 0;
+        for (const std::vector<BucketEdge>& edges : edgesOfThread) {
+            numberOfEdges += edges.size();
+        }
+        std::vector<BucketEdge> edges;
+        edges.reserve(numberOfEdges);
+        for (std::vector<BucketEdge>& threadEdges : edgesOfThread) {
+            edges.insert(edges.end(), threadEdges.begin(), threadEdges.end());
+            std::vector<BucketEdge>().swap(threadEdges);
+        }
+        std::sort(edges.begin(), edges.end());
+
+        CHConstructionGraph temp;
+        temp.addVertices(forward.numVertices());
+        for (const BucketEdge& edge : edges) {
+            temp.addEdge(edge.bucket, edge.poi).set(Weight, edge.weight);
+        }
+        ::Graph::move(std::move(temp), graph[I]);
+        graph[I].sortEdges(Weight);
+    }
+
+private:
+    CHGraph graph[2];
+    Vertex endOfPOIs;
+    size_t numberOfCHEdges;
+    u_int64_t checksum;
+
+};
+
+}
@@ -21,13 +21,13 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <string>
 
+#include "BucketGraph.h"
 #include "CHQuery.h"
 
-#include "../../../Helpers/Console/Progress.h"
-
 namespace CH {
 
 template<typename GRAPH = CHGraph, bool STALL_ON_DEMAND = true, bool DEBUG = false>
@@ -42,15 +42,19 @@ public:
     using BaseQuery = Query<Graph, StallOnDemand, false, true>;
 
 public:
-    BucketQuery(const Graph& forward, const Graph& backward, const std::vector<int>& forwardWeight, const std::vector<int>& backwardWeight, const Vertex::ValueType endOfPOIs) :
+    // Uses prebuilt bucket graphs, which may be shared with other queries.
+    BucketQuery(const Graph& forward, const Graph& backward, const std::vector<int>& forwardWeight, const std::vector<int>& backwardWeight, const std::shared_ptr<const BucketGraph>& bucketGraph) :
         baseQuery(forward, backward, forwardWeight, backwardWeight, forward.numVertices()),
-        bucketGraph {CHGraph(), CHGraph()},
+        bucketGraph(bucketGraph),
         distance {std::vector<int>(forward.numVertices(), INFTY), std::vector<int>(backward.numVertices(), INFTY)},
         root({noVertex, noVertex}),
-        endOfPOIs(endOfPOIs),
+        endOfPOIs(bucketGraph->getEndOfPOIs()),
         reachedPOIs {std::vector<Vertex>(), std::vector<Vertex>()} {
-        buildBucketGraph<FORWARD, BACKWARD>();
-        buildBucketGraph<BACKWARD, FORWARD>();
+        AssertMsg(bucketGraph->numVertices() == forward.numVertices(), "Bucket graph has " << bucketGraph->numVertices() << " vertices, but the CH has " << forward.numVertices() << "!");
+    }
+
+    BucketQuery(const Graph& forward, const Graph& backward, const std::vector<int>& forwardWeight, const std::vector<int>& backwardWeight, const Vertex::ValueType endOfPOIs) :
+        BucketQuery(forward, backward, forwardWeight, backwardWeight, buildBucketGraph(forward, backward, forwardWeight, backwardWeight, endOfPOIs)) {
     }
 
     template<typename ATTRIBUTE>
@@ -58,6 +62,11 @@ public:
         BucketQuery(forward, backward, forward[attribute], backward[attribute], endOfPOIs) {
     }
 
+    template<typename ATTRIBUTE>
+    BucketQuery(const Graph& forward, const Graph& backward, const std::shared_ptr<const BucketGraph>& bucketGraph, const ATTRIBUTE attribute = Weight) :
+        BucketQuery(forward, backward, forward[attribute], backward[attribute], bucketGraph) {
+    }
+
     BucketQuery(const CH& ch, const int direction = FORWARD, const Vertex::ValueType endOfPOIs = 0) :
         BucketQuery(ch.getGraph(direction), ch.getGraph(!direction), endOfPOIs, Weight) {
     }
@@ -179,28 +188,19 @@ public:
         return baseQuery.getStallCount();
     }
 
-private:
-    template<int I, int J>
-    inline void buildBucketGraph() noexcept {
-        if constexpr (Debug) std::cout << "Building " << ((I == FORWARD) ? ("forward") : ("backward")) << " bucket graph" << std::endl;
-        CHConstructionGraph temp;
-        temp.addVertices(distance[I].size());
-        Progress progress(endOfPOIs, Debug);
-        for (Vertex vertex = Vertex(0); vertex < endOfPOIs; vertex++) {
-            baseQuery.template run<J, I>(vertex);
-            for (const Vertex bucket : baseQuery.template getPOIs<J>()) {
-                AssertMsg(!temp.hasEdge(bucket, vertex), "Bucket graph contains already an edge from " << bucket << " to " << vertex << "!");
-                temp.addEdge(bucket, vertex).set(Weight, baseQuery.template getDistanceToPOI<J>(bucket));
-            }
-            progress++;
-        }
-        ::Graph::move(std::move(temp), bucketGraph[I]);
-        bucketGraph[I].sortEdges(Weight);
-        if constexpr (Debug) std::cout << std::endl;
-        if constexpr (Debug) ::Graph::printInfo(bucketGraph[I]);
-        if constexpr (Debug) bucketGraph[I].printAnalysis();
+    inline const std::shared_ptr<const BucketGraph>& getBucketGraph() const noexcept {
+        return bucketGraph;
     }
 
+    inline static std::shared_ptr<const BucketGraph> buildBucketGraph(const Graph& forward, const Graph& backward, const std::vector<int>& forwardWeight, const std::vector<int>& backwardWeight, const Vertex::ValueType endOfPOIs) noexcept {
+        std::shared_ptr<BucketGraph> result = std::make_shared<BucketGraph>();
+        result->template build<StallOnDemand>(forward, backward, forwardWeight, backwardWeight, endOfPOIs, ThreadPinning(1, 1), Debug);
+        if constexpr (Debug) ::Graph::printInfo(result->getGraph(FORWARD));
+        if constexpr (Debug) ::Graph::printInfo(result->getGraph(BACKWARD));
+        return result;
+    }
+
+private:
     template<int DIRECTION>
     inline void clear() noexcept {
         for (const Vertex vertex : reachedPOIs[DIRECTION]) {
@@ -212,12 +212,13 @@ private:
     template<int DIRECTION>
     inline void collectPOIs() noexcept {
         const int maxDistance = baseQuery.getDistance();
+        const CHGraph& buckets = bucketGraph->getGraph(DIRECTION);
         for (const Vertex vertex : baseQuery.template getPOIs<DIRECTION>()) {
             if (baseQuery.template getDistanceToPOI<DIRECTION>(vertex) > maxDistance) break;
-            for (const Edge edge : bucketGraph[DIRECTION].edgesFrom(vertex)) {
-                const int newDistance = baseQuery.template getDistanceToPOI<DIRECTION>(vertex) + bucketGraph[DIRECTION].get(Weight, edge);
+            for (const Edge edge : buckets.edgesFrom(vertex)) {
+                const int newDistance = baseQuery.template getDistanceToPOI<DIRECTION>(vertex) + buckets.get(Weight, edge);
                 if (newDistance > maxDistance) break;
-                const Vertex poi = bucketGraph[DIRECTION].get(ToVertex, edge);
+                const Vertex poi = buckets.get(ToVertex, edge);
                 if (distance[DIRECTION][poi] == INFTY) {
                     reachedPOIs[DIRECTION].emplace_back(poi);
                     distance[DIRECTION][poi] = newDistance;
@@ -231,7 +232,7 @@ private:
 private:
     BaseQuery baseQuery;
 
-    CHGraph bucketGraph[2];
+    std::shared_ptr<const BucketGraph> bucketGraph;
     std::vector<int> distance[2];
 
     Vertex root[2];
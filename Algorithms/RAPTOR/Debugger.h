@@ -27,6 +27,7 @@
 
 #include "../../DataStructures/RAPTOR/Data.h"
 
+#include "../../Helpers/AllocationCounter.h"
 #include "../../Helpers/Timer.h"
 
 namespace RAPTOR {
@@ -76,6 +77,9 @@ public:
         vertexCount(0),
         routeCount(0),
         roundCount(0),
+        allocationsAtStart(0),
+        allocationCount(0),
+        allocatingQueryCount(0),
         initialTime(0),
         totalTime(0) {
     }
@@ -83,11 +87,15 @@ public:
 public:
     inline void start() noexcept {
         roundCount++;
+        allocationsAtStart = AllocationCounter::count();
         totalTimer.restart();
     }
 
     inline void done() noexcept {
         totalTime += totalTimer.elapsedMicroseconds();
+        const size_t allocations = AllocationCounter::count() - allocationsAtStart;
+        allocationCount += allocations;
+        if (allocations > 0) allocatingQueryCount++;
     }
 
     inline void newRound() noexcept {
@@ -122,12 +130,18 @@ public:
         std::cout << "Number of scanned routes: " << String::prettyDouble(routeCount / f, 0) << std::endl;
         std::cout << "Number of settled vertices: " << String::prettyDouble(vertexCount / f, 0) << std::endl;
         std::cout << "Number of rounds: " << String::prettyDouble(roundCount / f, 2) << std::endl;
+        if constexpr (AllocationCounter::Enabled) {
+            std::cout << "Number of heap allocations: " << String::prettyDouble(allocationCount / f, 2) << std::endl;
+            std::cout << "Queries with heap allocations: " << String::prettyInt(allocatingQueryCount) << std::endl;
+        }
         std::cout << "Initial transfers time: " << String::musToString(initialTime / f) << std::endl;
         std::cout << "Total time: " << String::musToString(totalTime / f) << std::endl;
         stopCount = 0;
         vertexCount = 0;
         routeCount = 0;
         roundCount = 0;
+        allocationCount = 0;
+        allocatingQueryCount = 0;
         initialTime = 0;
         totalTime = 0;
     }
@@ -138,6 +152,10 @@ public:
     size_t routeCount;
     size_t roundCount;
 
+    size_t allocationsAtStart;
+    size_t allocationCount;
+    size_t allocatingQueryCount;
+
     Timer initialTimer;
     double initialTime;
 
@@ -21,13 +21,17 @@
 #pragma once
 
 #include <algorithm>
+#include <string>
 
 #include "../../../DataStructures/RAPTOR/Data.h"
+#include "../../../DataStructures/RAPTOR/Entities/Shortcut.h"
 #include "../../../Helpers/MultiThreading.h"
 #include "../../../Helpers/Timer.h"
 #include "../../../Helpers/Console/Progress.h"
+#include "../../../Helpers/IO/Serialization.h"
 
 #include "ShortcutSearch.h"
+#include "ShortcutSearchSchedule.h"
 
 namespace RAPTOR::ULTRA {
 
@@ -40,61 +44,245 @@ public:
     inline static constexpr bool RequireDirectTransfer = REQUIRE_DIRECT_TRANSFER;
     using Type = Builder<Debug, PruneWithExistingShortcuts, RequireDirectTransfer>;
 
+    using Job = ShortcutSearchSchedule::Job;
+    using Checkpoint = ShortcutSearchSchedule::Checkpoint<Shortcut>;
+
 public:
     Builder(const Data& data) :
-        data(data) {
-        shortcutGraph.addVertices(data.numberOfStops());
+        data(data),
+        numberOfShortcuts(0),
+        checkpointInterval(0) {
+        shortcutGraph.setAdjacencyStructure(std::vector<Edge>(data.numberOfStops() + 1, Edge(0)));
         for (const Vertex vertex : shortcutGraph.vertices()) {
             shortcutGraph.set(Coordinates, vertex, data.transferGraph.get(Coordinates, vertex));
         }
     }
 
-    void computeShortcuts(const ThreadPinning& threadPinning, const int witnessTransferLimit = 15 * 60, const int minDepartureTime = -never, const int maxDepartureTime = never, const bool verbose = true) noexcept {
+    // While computing shortcuts, the shortcuts found so far and the completed jobs are periodically saved to the file.
+    inline void enableCheckpoints(const std::string& fileName, const double intervalInSeconds) noexcept {
+        checkpointFile = fileName;
+        checkpointInterval = intervalInSeconds * 1000;
+    }
+
+    // Continues a previous run of computeShortcuts() with the same parameters, skipping the jobs completed before the checkpoint.
+    // The shortcuts of the checkpoint are available for pruning from the start.
+    inline void resumeFromCheckpoint(const std::string& fileName) noexcept {
+        size_t numberOfStops = 0;
+        std::vector<Job> checkpointJobs;
+        std::vector<Shortcut> checkpointShortcuts;
+        IO::deserialize(fileName, numberOfStops, checkpointJobs, checkpointShortcuts);
+        Ensure(numberOfStops == data.numberOfStops(), "Checkpoint " << fileName << " was written for " << numberOfStops << " stops, but the network has " << data.numberOfStops() << "!");
+        completedJobs.insert(completedJobs.end(), checkpointJobs.begin(), checkpointJobs.end());
+        shortcuts.insert(shortcuts.end(), checkpointShortcuts.begin(), checkpointShortcuts.end());
+        std::cout << "Resuming from checkpoint with " << String::prettyInt(checkpointJobs.size()) << " completed jobs and " << String::prettyInt(checkpointShortcuts.size()) << " shortcuts." << std::endl;
+    }
+
+    void computeShortcuts(const ThreadPinning& threadPinning, const int witnessTransferLimit = 15 * 60, const int minDepartureTime = -never, const int maxDepartureTime = never, const bool verbose = true, const size_t maxDeparturesPerJob = 0, const size_t shard = 0, const size_t numberOfShards = 1) noexcept {
         if (verbose) std::cout << "Computing shortcuts with " << threadPinning.numberOfThreads << " threads." << std::endl;
+        AssertMsg(shard < numberOfShards, "Shard " << shard << " is out of range (number of shards: " << numberOfShards << ")!");
+
+        if (!shortcuts.empty()) {
+            buildShortcutGraph(threadPinning);
+            shortcuts.clear();
+            for (const auto [edge, from] : shortcutGraph.edgesWithFromVertex()) {
+                shortcuts.emplace_back(StopId(from), StopId(shortcutGraph.get(ToVertex, edge)), shortcutGraph.get(TravelTime, edge));
+            }
+        }
 
+        ShortcutSearchSchedule schedule(threadPinning.numberOfThreads, maxDeparturesPerJob, checkpointFile.empty() ? 0 : checkpointInterval);
         Progress progress(data.numberOfStops(), verbose);
+        Timer mergeTimer;
         omp_set_num_threads(threadPinning.numberOfThreads);
         #pragma omp parallel
         {
             threadPinning.pinThread();
 
-            DynamicTransferGraph localShortcutGraph = shortcutGraph;
+            DynamicTransferGraph localShortcutGraph;
+            localShortcutGraph.addVertices(data.numberOfStops());
+            for (const Shortcut& shortcut : shortcuts) {
+                localShortcutGraph.addEdge(shortcut.origin, shortcut.destination).set(TravelTime, shortcut.travelTime);
+            }
             ShortcutSearch<PruneWithExistingShortcuts, Debug, RequireDirectTransfer> shortcutSearch(data, localShortcutGraph, witnessTransferLimit);
 
             #pragma omp for schedule(dynamic)
             for (size_t i = 0; i < data.numberOfStops(); i++) {
-                shortcutSearch.run(StopId(i), minDepartureTime, maxDepartureTime);
-                progress++;
+                if (i % numberOfShards != shard) continue;
+                schedule.addSource(StopId(i), shortcutSearch.getDepartureTimes(StopId(i), minDepartureTime, maxDepartureTime), minDepartureTime, maxDepartureTime);
             }
 
-            #pragma omp critical
+            #pragma omp single
             {
-                for (const Vertex from : shortcutGraph.vertices()) {
-                    for (const Edge edge : localShortcutGraph.edgesFrom(from)) {
-                        const Vertex to = localShortcutGraph.get(ToVertex, edge);
-                        if (!shortcutGraph.hasEdge(from, to)) {
-                            shortcutGraph.addEdge(from, to).set(TravelTime, localShortcutGraph.get(TravelTime, edge));
-                        } else {
-                            AssertMsg(shortcutGraph.get(TravelTime, shortcutGraph.findEdge(from, to)) == localShortcutGraph.get(TravelTime, edge), "Edge from " << from << " to " << to << " has inconclusive travel time (" << shortcutGraph.get(TravelTime, shortcutGraph.findEdge(from, to)) << ", " << localShortcutGraph.get(TravelTime, edge) << ")");
-                        }
+                schedule.sortJobs();
+                schedule.removeJobs(completedJobs);
+                progress.init(schedule.numberOfJobs());
+            }
+
+            Timer jobTimer;
+            size_t numberOfFlushedShortcuts = 0;
+            #pragma omp for schedule(dynamic,1) nowait
+            for (size_t i = 0; i < schedule.numberOfJobs(); i++) {
+                jobTimer.restart();
+                shortcutSearch.run(schedule[i].source, schedule[i].minDepartureTime, schedule[i].maxDepartureTime);
+                schedule.addBusyTime(jobTimer.elapsedMilliseconds());
+                schedule.completeJob(i);
+                progress++;
+                if (schedule.isCheckpointDue()) {
+                    Checkpoint checkpoint;
+                    #pragma omp critical
+                    {
+                        numberOfFlushedShortcuts = flushShortcuts(shortcutSearch.getShortcuts(), numberOfFlushedShortcuts);
+                        if (schedule.flushCompletedJobs(completedJobs)) checkpoint = schedule.takeCheckpoint(completedJobs, shortcuts);
                     }
+                    if (checkpoint.id > 0) schedule.writeCheckpoint(checkpointFile, data.numberOfStops(), checkpoint);
                 }
             }
+            schedule.finishThread();
+
+            #pragma omp barrier
+            #pragma omp single
+            {
+                mergeTimer.restart();
+                numberOfShortcuts = shortcuts.size();
+            }
+
+            const std::vector<Shortcut>& localShortcuts = shortcutSearch.getShortcuts();
+            size_t offset;
+            #pragma omp atomic capture
+            {
+                offset = numberOfShortcuts;
+                numberOfShortcuts += localShortcuts.size() - numberOfFlushedShortcuts;
+            }
+
+            #pragma omp barrier
+            #pragma omp single
+            shortcuts.resize(numberOfShortcuts);
+
+            std::copy(localShortcuts.begin() + numberOfFlushedShortcuts, localShortcuts.end(), shortcuts.begin() + offset);
         }
+        buildShortcutGraph(threadPinning);
         progress.finished();
+        if (verbose) {
+            std::cout << "Merged " << String::prettyInt(shortcuts.size()) << " thread-local shortcuts into " << String::prettyInt(shortcutGraph.numEdges()) << " edges in " << String::msToString(mergeTimer.elapsedMilliseconds()) << std::endl;
+            schedule.printStatistics();
+        }
     }
 
-    inline const DynamicTransferGraph& getShortcutGraph() const noexcept {
+    // Partial results of computeShortcuts() for a shard or a departure time range can be written to disk and
+    // merged into the shortcut graph of another builder with readShortcuts() and buildShortcutGraph() afterwards.
+    inline void writeShortcuts(const std::string& fileName) const noexcept {
+        shortcutGraph.writeBinary(fileName);
+    }
+
+    inline void readShortcuts(const std::string& fileName) noexcept {
+        TransferGraph partialShortcutGraph;
+        partialShortcutGraph.readBinary(fileName);
+        Ensure(partialShortcutGraph.numVertices() == data.numberOfStops(), "Shortcuts in " << fileName << " were computed for " << partialShortcutGraph.numVertices() << " stops, but the network has " << data.numberOfStops() << "!");
+        for (const auto [edge, from] : partialShortcutGraph.edgesWithFromVertex()) {
+            shortcuts.emplace_back(StopId(from), StopId(partialShortcutGraph.get(ToVertex, edge)), partialShortcutGraph.get(TravelTime, edge));
+        }
+    }
+
+    // Builds the shortcut graph directly in CSR format: The shortcuts are distributed to their origins with a parallel
+    // counting sort, afterwards the shortcuts of each origin are sorted and deduplicated independently.
+    inline void buildShortcutGraph(const ThreadPinning& threadPinning = ThreadPinning(numberOfCores(), 1)) noexcept {
+        const size_t numberOfStops = data.numberOfStops();
+        std::vector<size_t> firstShortcutOfOrigin(numberOfStops + 1, 0);
+        std::vector<size_t> nextShortcutOfOrigin;
+        std::vector<Shortcut> sortedShortcuts(shortcuts.size());
+        std::vector<Edge> beginOut(numberOfStops + 1, Edge(0));
+        omp_set_num_threads(threadPinning.numberOfThreads);
+        #pragma omp parallel
+        {
+            threadPinning.pinThread();
+
+            #pragma omp for
+            for (size_t i = 0; i < shortcuts.size(); i++) {
+                #pragma omp atomic
+                firstShortcutOfOrigin[shortcuts[i].origin + 1]++;
+            }
+
+            #pragma omp single
+            {
+                for (size_t i = 1; i <= numberOfStops; i++) {
+                    firstShortcutOfOrigin[i] += firstShortcutOfOrigin[i - 1];
+                }
+                nextShortcutOfOrigin.assign(firstShortcutOfOrigin.begin(), firstShortcutOfOrigin.end() - 1);
+            }
+
+            #pragma omp for
+            for (size_t i = 0; i < shortcuts.size(); i++) {
+                size_t index;
+                #pragma omp atomic capture
+                index = nextShortcutOfOrigin[shortcuts[i].origin]++;
+                sortedShortcuts[index] = shortcuts[i];
+            }
+
+            #pragma omp for schedule(dynamic,64)
+            for (size_t origin = 0; origin < numberOfStops; origin++) {
+                const auto begin = sortedShortcuts.begin() + firstShortcutOfOrigin[origin];
+                const auto end = sortedShortcuts.begin() + firstShortcutOfOrigin[origin + 1];
+                std::sort(begin, end, [](const Shortcut& a, const Shortcut& b){
+                    return a.destination < b.destination;
+                });
+                auto last = begin;
+                for (auto i = begin; i != end; i++) {
+                    if (last != begin && (last - 1)->destination == i->destination) {
+                        AssertMsg((last - 1)->travelTime == i->travelTime, "Edge from " << origin << " to " << i->destination << " has inconclusive travel time (" << (last - 1)->travelTime << ", " << i->travelTime << ")");
+                        continue;
+                    }
+                    *(last++) = *i;
+                }
+                beginOut[origin + 1] = Edge(last - begin);
+            }
+
+            #pragma omp single
+            {
+                for (size_t i = 1; i <= numberOfStops; i++) {
+                    beginOut[i] += beginOut[i - 1];
+                }
+                shortcutGraph.setAdjacencyStructure(std::move(beginOut));
+            }
+
+            #pragma omp for schedule(dynamic,64)
+            for (size_t origin = 0; origin < numberOfStops; origin++) {
+                shortcutGraph.set(Coordinates, Vertex(origin), data.transferGraph.get(Coordinates, Vertex(origin)));
+                const Shortcut* shortcut = &(sortedShortcuts[firstShortcutOfOrigin[origin]]);
+                for (const Edge edge : shortcutGraph.edgesFrom(Vertex(origin))) {
+                    shortcutGraph.set(ToVertex, edge, Vertex(shortcut->destination));
+                    shortcutGraph.set(TravelTime, edge, shortcut->travelTime);
+                    shortcut++;
+                }
+            }
+        }
+    }
+
+    inline const std::vector<Shortcut>& getShortcuts() const noexcept {
+        return shortcuts;
+    }
+
+    inline const TransferGraph& getShortcutGraph() const noexcept {
         return shortcutGraph;
     }
 
-    inline DynamicTransferGraph& getShortcutGraph() noexcept {
+    inline TransferGraph& getShortcutGraph() noexcept {
         return shortcutGraph;
     }
 
+private:
+    inline size_t flushShortcuts(const std::vector<Shortcut>& localShortcuts, const size_t numberOfFlushedShortcuts) noexcept {
+        shortcuts.insert(shortcuts.end(), localShortcuts.begin() + numberOfFlushedShortcuts, localShortcuts.end());
+        return localShortcuts.size();
+    }
+
 private:
     const Data& data;
-    DynamicTransferGraph shortcutGraph;
+    std::vector<Shortcut> shortcuts;
+    size_t numberOfShortcuts;
+    TransferGraph shortcutGraph;
+
+    std::string checkpointFile;
+    double checkpointInterval;
+    std::vector<Job> completedJobs;
 
 };
 
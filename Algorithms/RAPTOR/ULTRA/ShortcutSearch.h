@@ -20,11 +20,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <vector>
 #include <string>
 
 #include "../../Dijkstra/Dijkstra.h"
+#include "ShortcutSearchSchedule.h"
 
 #include "../../../Helpers/Meta.h"
 #include "../../../Helpers/Helpers.h"
@@ -33,6 +36,7 @@
 #include "../../../DataStructures/Container/Set.h"
 #include "../../../DataStructures/Container/ExternalKHeap.h"
 #include "../../../DataStructures/RAPTOR/Data.h"
+#include "../../../DataStructures/RAPTOR/Entities/Shortcut.h"
 
 namespace RAPTOR::ULTRA {
 
@@ -120,6 +124,7 @@ public:
                 const StopId shortcutOrigin = getShortcutOriginStop(shortcutDestination);
                 if (!shortcutGraph.hasEdge(shortcutOrigin, shortcutDestination)) {
                     shortcutGraph.addEdge(shortcutOrigin, shortcutDestination).set(TravelTime, getShortcutTravelTime(shortcutDestination));
+                    shortcuts.emplace_back(shortcutOrigin, shortcutDestination, getShortcutTravelTime(shortcutDestination));
                 } else {
                     AssertMsg(shortcutGraph.get(TravelTime, shortcutGraph.findEdge(shortcutOrigin, shortcutDestination)) == getShortcutTravelTime(shortcutDestination), "Edge from " << shortcutOrigin << " to " << shortcutDestination << " has inconclusive travel time (" << shortcutGraph.get(TravelTime, shortcutGraph.findEdge(shortcutOrigin, shortcutDestination)) << ", " << getShortcutTravelTime(shortcutDestination) << ")");
                 }
@@ -127,6 +132,18 @@ public:
         }
     }
 
+    // Shortcuts in the order in which they were added to the shortcut graph.
+    inline const std::vector<Shortcut>& getShortcuts() const noexcept {
+        return shortcuts;
+    }
+
+    // Departure times at the stops of the source station within [minTime, maxTime] in descending order. Every one of
+    // them starts an iteration of run(source, minTime, maxTime), so their number estimates the cost of the source.
+    inline std::vector<int> getDepartureTimes(const StopId source, const int minTime, const int maxTime) const noexcept {
+        if (stationOfStop[source].representative != source) return std::vector<int>();
+        return ULTRA::ShortcutSearchSchedule::GetDepartureTimes(data, stationOfStop[source].stops, std::max(minTime, earliestDepartureTime), maxTime);
+    }
+
 private:
     inline void setSource(const StopId sourceStop) noexcept {
         AssertMsg(directTransferQueue.empty(), "Queue for round 0 is not empty!");
@@ -569,6 +586,7 @@ private:
 private:
     const Data& data;
     DynamicTransferGraph& shortcutGraph;
+    std::vector<Shortcut> shortcuts;
     std::vector<Station> stationOfStop;
 
     Station sourceStation;
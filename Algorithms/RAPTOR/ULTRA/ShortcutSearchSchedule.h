@@ -0,0 +1,269 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <omp.h>
+
+#include "../../../Helpers/Assert.h"
+#include "../../../Helpers/Timer.h"
+#include "../../../Helpers/Types.h"
+#include "../../../Helpers/HighlightText.h"
+#include "../../../Helpers/IO/Serialization.h"
+#include "../../../Helpers/String/String.h"
+#include "../../../Helpers/Vector/Vector.h"
+
+#include "../../../DataStructures/RAPTOR/Data.h"
+
+namespace RAPTOR::ULTRA {
+
+// Distributes the sources of an ULTRA shortcut computation to the threads of an omp parallel region.
+// The cost of a source is estimated by its number of departures, and expensive sources are processed first.
+// Sources with more than maxDeparturesPerJob departures are split into departure time ranges, which are
+// processed independently. This may produce a few superfluous shortcuts, since the searches for the earlier
+// departures do not see the witnesses of the later ones.
+class ShortcutSearchSchedule {
+
+public:
+    // Departure times at the given stops within [minTime, maxTime] in descending order and without duplicates. This is
+    // the set of departure times iterated by the ULTRA shortcut searches of a source station, so its size estimates the
+    // cost of the source.
+    inline static std::vector<int> GetDepartureTimes(const Data& data, const std::vector<StopId>& stops, const int minTime, const int maxTime) noexcept {
+        std::vector<int> departureTimes;
+        for (const StopId stop : stops) {
+            for (const RouteSegment& route : data.routesContainingStop(stop)) {
+                const size_t tripSize = data.numberOfStopsInRoute(route.routeId);
+                if (route.stopIndex + 1 == tripSize) continue;
+                for (const StopEvent* trip = data.firstTripOfRoute(route.routeId); trip <= data.lastTripOfRoute(route.routeId); trip += tripSize) {
+                    const int departureTime = trip[route.stopIndex].departureTime;
+                    if (departureTime < minTime) continue;
+                    if (departureTime > maxTime) break;
+                    departureTimes.emplace_back(departureTime);
+                }
+            }
+        }
+        std::sort(departureTimes.begin(), departureTimes.end(), std::greater<int>());
+        departureTimes.erase(std::unique(departureTimes.begin(), departureTimes.end()), departureTimes.end());
+        return departureTimes;
+    }
+
+public:
+    struct Job {
+        Job(const StopId source = noStop, const int minDepartureTime = -never, const int maxDepartureTime = never, const size_t numberOfDepartures = 0) :
+            source(source),
+            minDepartureTime(minDepartureTime),
+            maxDepartureTime(maxDepartureTime),
+            numberOfDepartures(numberOfDepartures) {
+        }
+
+        inline static bool CompareRanges(const Job& a, const Job& b) noexcept {
+            return std::tie(a.source, a.minDepartureTime, a.maxDepartureTime) < std::tie(b.source, b.minDepartureTime, b.maxDepartureTime);
+        }
+
+        inline bool operator<(const Job& other) const noexcept {
+            return (numberOfDepartures > other.numberOfDepartures) || ((numberOfDepartures == other.numberOfDepartures) && ((source < other.source) || ((source == other.source) && (maxDepartureTime > other.maxDepartureTime))));
+        }
+
+        StopId source;
+        int minDepartureTime;
+        int maxDepartureTime;
+        size_t numberOfDepartures;
+    };
+
+    // Copy of the completed jobs and their shortcuts, taken within the critical section and written outside of it.
+    template<typename SHORTCUT>
+    struct Checkpoint {
+        size_t id{0};
+        std::vector<Job> completedJobs;
+        std::vector<SHORTCUT> shortcuts;
+    };
+
+public:
+    ShortcutSearchSchedule(const size_t numberOfThreads, const size_t maxDeparturesPerJob = 0, const double checkpointInterval = 0) :
+        maxDeparturesPerJob(maxDeparturesPerJob),
+        jobsOfThread(numberOfThreads),
+        numberOfSkippedJobs(0),
+        busyTime(numberOfThreads, 0),
+        finishTime(numberOfThreads, 0),
+        numberOfSplitSources(numberOfThreads, 0),
+        checkpointInterval(checkpointInterval),
+        completedJobsOfThread(numberOfThreads),
+        lastFlushTime(numberOfThreads, 0),
+        lastCheckpointTime(0),
+        numberOfCheckpoints(0),
+        lastWrittenCheckpoint(0) {
+    }
+
+    // Adds the jobs for a source, given its departure times in descending order. Called by the calling thread only.
+    inline void addSource(const StopId source, const std::vector<int>& departureTimes, const int minDepartureTime, const int maxDepartureTime) noexcept {
+        if (departureTimes.empty()) return;
+        const size_t threadId = omp_get_thread_num();
+        AssertMsg(threadId < jobsOfThread.size(), "Thread " << threadId << " is out of range!");
+        if ((maxDeparturesPerJob == 0) || (departureTimes.size() <= maxDeparturesPerJob)) {
+            jobsOfThread[threadId].emplace_back(source, minDepartureTime, maxDepartureTime, departureTimes.size());
+            return;
+        }
+        numberOfSplitSources[threadId]++;
+        int jobMaxDepartureTime = maxDepartureTime;
+        for (size_t first = 0; first < departureTimes.size(); first += maxDeparturesPerJob) {
+            const size_t last = std::min(first + maxDeparturesPerJob, departureTimes.size()) - 1;
+            const int jobMinDepartureTime = (last + 1 == departureTimes.size()) ? minDepartureTime : departureTimes[last];
+            jobsOfThread[threadId].emplace_back(source, jobMinDepartureTime, jobMaxDepartureTime, last - first + 1);
+            jobMaxDepartureTime = jobMinDepartureTime - 1;
+        }
+    }
+
+    // Merges the jobs of all threads and orders them by decreasing cost. Has to be called by a single thread.
+    inline void sortJobs() noexcept {
+        jobs.clear();
+        for (std::vector<Job>& localJobs : jobsOfThread) {
+            jobs.insert(jobs.end(), localJobs.begin(), localJobs.end());
+            std::vector<Job>().swap(localJobs);
+        }
+        std::sort(jobs.begin(), jobs.end());
+        timer.restart();
+    }
+
+    // Removes the jobs that were completed before the last checkpoint. Has to be called by a single thread after sortJobs().
+    inline void removeJobs(std::vector<Job> completedJobs) noexcept {
+        std::sort(completedJobs.begin(), completedJobs.end(), Job::CompareRanges);
+        const size_t oldNumberOfJobs = jobs.size();
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&](const Job& job) {
+            return std::binary_search(completedJobs.begin(), completedJobs.end(), job, Job::CompareRanges);
+        }), jobs.end());
+        numberOfSkippedJobs += oldNumberOfJobs - jobs.size();
+    }
+
+    inline size_t numberOfJobs() const noexcept {
+        return jobs.size();
+    }
+
+    inline const Job& operator[](const size_t i) const noexcept {
+        AssertMsg(i < jobs.size(), "Job " << i << " is out of range!");
+        return jobs[i];
+    }
+
+    inline void addBusyTime(const double time) noexcept {
+        busyTime[omp_get_thread_num()] += time;
+    }
+
+    inline void completeJob(const size_t i) noexcept {
+        if (checkpointInterval <= 0) return;
+        completedJobsOfThread[omp_get_thread_num()].emplace_back(jobs[i]);
+    }
+
+    // True if the calling thread has not handed over its completed jobs for longer than the checkpoint interval.
+    inline bool isCheckpointDue() const noexcept {
+        if (checkpointInterval <= 0) return false;
+        return timer.elapsedMilliseconds() - lastFlushTime[omp_get_thread_num()] >= checkpointInterval;
+    }
+
+    // Moves the jobs completed by the calling thread to completedJobs and returns whether a checkpoint should be written.
+    // Has to be called within a critical section, together with handing over the results of these jobs.
+    inline bool flushCompletedJobs(std::vector<Job>& completedJobs) noexcept {
+        const size_t threadId = omp_get_thread_num();
+        const double time = timer.elapsedMilliseconds();
+        completedJobs.insert(completedJobs.end(), completedJobsOfThread[threadId].begin(), completedJobsOfThread[threadId].end());
+        completedJobsOfThread[threadId].clear();
+        lastFlushTime[threadId] = time;
+        if (time - lastCheckpointTime < checkpointInterval) return false;
+        lastCheckpointTime = time;
+        return true;
+    }
+
+    // Has to be called within the same critical section as flushCompletedJobs().
+    template<typename SHORTCUT>
+    inline Checkpoint<SHORTCUT> takeCheckpoint(const std::vector<Job>& completedJobs, const std::vector<SHORTCUT>& shortcuts) noexcept {
+        return Checkpoint<SHORTCUT>{++numberOfCheckpoints, completedJobs, shortcuts};
+    }
+
+    // Writes the checkpoint to a temporary file and renames it, so an interrupted write never replaces the previous checkpoint.
+    // Writes are serialized, and a checkpoint that was overtaken by a newer one is dropped.
+    template<typename SHORTCUT>
+    inline void writeCheckpoint(const std::string& fileName, const size_t networkSize, const Checkpoint<SHORTCUT>& checkpoint) noexcept {
+        #pragma omp critical(writeCheckpoint)
+        {
+            if (checkpoint.id > lastWrittenCheckpoint) {
+                const std::string tempFileName = fileName + ".tmp";
+                IO::serialize(tempFileName, networkSize, checkpoint.completedJobs, checkpoint.shortcuts);
+                if (std::rename(tempFileName.c_str(), fileName.c_str()) == 0) {
+                    lastWrittenCheckpoint = checkpoint.id;
+                } else {
+                    warning("Could not rename ", tempFileName, " to ", fileName, ", the checkpoint was not written!");
+                }
+            }
+        }
+    }
+
+    // Called by every thread once it has run out of jobs.
+    inline void finishThread() noexcept {
+        finishTime[omp_get_thread_num()] = timer.elapsedMilliseconds();
+    }
+
+    inline std::vector<double> getIdleTimes() const noexcept {
+        const double totalTime = Vector::max(finishTime);
+        std::vector<double> idleTime;
+        for (const double time : finishTime) {
+            idleTime.emplace_back(totalTime - time);
+        }
+        return idleTime;
+    }
+
+    inline void printStatistics() const noexcept {
+        const std::vector<double> idleTime = getIdleTimes();
+        std::cout << "Number of jobs: " << String::prettyInt(jobs.size()) << " (" << String::prettyInt(Vector::sum(numberOfSplitSources)) << " sources split into departure time ranges)" << std::endl;
+        if (numberOfSkippedJobs > 0) std::cout << "Jobs completed before the last checkpoint: " << String::prettyInt(numberOfSkippedJobs) << std::endl;
+        if (!jobs.empty()) std::cout << "Departures of the most expensive job: " << String::prettyInt(jobs.front().numberOfDepartures) << std::endl;
+        for (size_t i = 0; i < idleTime.size(); i++) {
+            std::cout << "   Thread " << i << ": busy " << String::msToString(busyTime[i]) << ", idle " << String::msToString(idleTime[i]) << std::endl;
+        }
+        std::cout << "Total idle time: " << String::msToString(Vector::sum(idleTime)) << " (" << String::percent(Vector::sum(idleTime) / (Vector::max(finishTime) * idleTime.size())) << " of the thread time)" << std::endl;
+    }
+
+private:
+    size_t maxDeparturesPerJob;
+
+    std::vector<std::vector<Job>> jobsOfThread;
+    std::vector<Job> jobs;
+    size_t numberOfSkippedJobs;
+
+    Timer timer;
+    std::vector<double> busyTime;
+    std::vector<double> finishTime;
+    std::vector<size_t> numberOfSplitSources;
+
+    double checkpointInterval;
+    std::vector<std::vector<Job>> completedJobsOfThread;
+    std::vector<double> lastFlushTime;
+    double lastCheckpointTime;
+    size_t numberOfCheckpoints;
+    size_t lastWrittenCheckpoint;
+
+};
+
+}
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -57,9 +58,10 @@ private:
 
 public:
     template<typename ATTRIBUTE>
-    ULTRARAPTOR(const Data& data, const CHGraph& forwardGraph, const CHGraph& backwardGraph, const ATTRIBUTE weight, const Debugger& debuggerTemplate = Debugger()) :
+    ULTRARAPTOR(const Data& data, const CHGraph& forwardGraph, const CHGraph& backwardGraph, const ATTRIBUTE weight, const std::shared_ptr<const CH::BucketGraph>& bucketGraph, const Debugger& debuggerTemplate = Debugger()) :
         data(data),
-        initialTransfers(forwardGraph, backwardGraph, data.numberOfStops(), weight),
+        initialTransfers(forwardGraph, backwardGraph, bucketGraph, weight),
+        numberOfRounds(0),
         earliestArrival(data.numberOfStops() + 1),
         stopsUpdatedByRoute(data.numberOfStops() + 1),
         stopsUpdatedByTransfer(data.numberOfStops() + 1),
@@ -72,10 +74,19 @@ public:
         debugger.initialize(data);
     }
 
+    template<typename ATTRIBUTE>
+    ULTRARAPTOR(const Data& data, const CHGraph& forwardGraph, const CHGraph& backwardGraph, const ATTRIBUTE weight, const Debugger& debuggerTemplate = Debugger()) :
+        ULTRARAPTOR(data, forwardGraph, backwardGraph, weight, BucketCHInitialTransfers::buildBucketGraph(forwardGraph, backwardGraph, forwardGraph[weight], backwardGraph[weight], data.numberOfStops()), debuggerTemplate) {
+    }
+
     ULTRARAPTOR(const Data& data, const CH::CH& chData, const Debugger& debuggerTemplate = Debugger()) :
         ULTRARAPTOR(data, chData.forward, chData.backward, Weight, debuggerTemplate) {
     }
 
+    ULTRARAPTOR(const Data& data, const CH::CH& chData, const std::shared_ptr<const CH::BucketGraph>& bucketGraph, const Debugger& debuggerTemplate = Debugger()) :
+        ULTRARAPTOR(data, chData.forward, chData.backward, Weight, bucketGraph, debuggerTemplate) {
+    }
+
     inline void run(const Vertex source, const int departureTime, const Vertex target, const size_t maxRounds = 50) noexcept {
         debugger.start();
         debugger.startInitialization();
@@ -100,7 +111,7 @@ public:
 
     inline int getEarliestArrivalNumberOfTrips() const noexcept {
     const int eat = earliestArrival[targetStop];
-        for (size_t i = rounds.size() - 1; i < rounds.size(); i--) {
+        for (size_t i = numberOfRounds - 1; i < numberOfRounds; i--) {
             if (rounds[i][targetStop].arrivalTime == eat) return i;
         }
         return -1;
@@ -122,10 +133,11 @@ private:
         routesServingUpdatedStops.clear();
         targetStop = StopId(data.numberOfStops());
         if constexpr (RESET_CAPACITIES) {
+            numberOfRounds = 0;
             std::vector<Round>().swap(rounds);
             std::vector<int>(earliestArrival.size(), never).swap(earliestArrival);
         } else {
-            rounds.clear();
+            numberOfRounds = 0;
             Vector::fill(earliestArrival, never);
         }
     }
@@ -279,17 +291,23 @@ private:
     }
 
     inline Round& currentRound() noexcept {
-        AssertMsg(!rounds.empty(), "Cannot return current round, because no round exists!");
-        return rounds.back();
+        AssertMsg(numberOfRounds >= 1, "Cannot return current round, because no round exists!");
+        return rounds[numberOfRounds - 1];
     }
 
     inline Round& previousRound() noexcept {
-        AssertMsg(rounds.size() >= 2, "Cannot return previous round, because less than two rounds exist!");
-        return rounds[rounds.size() - 2];
+        AssertMsg(numberOfRounds >= 2, "Cannot return previous round, because less than two rounds exist!");
+        return rounds[numberOfRounds - 2];
     }
 
     inline void startNewRound() noexcept {
-        rounds.emplace_back(data.numberOfStops() + 1);
+        // Rounds are kept allocated across queries and only reinitialized when they are reused.
+        if (numberOfRounds < rounds.size()) {
+            Vector::fill(rounds[numberOfRounds], EarliestArrivalLabel());
+        } else {
+            rounds.emplace_back(data.numberOfStops() + 1);
+        }
+        numberOfRounds++;
     }
 
     inline bool arrivalByRoute(const StopId stop, const int time) noexcept {
@@ -319,6 +337,7 @@ private:
     BucketCHInitialTransfers initialTransfers;
 
     std::vector<Round> rounds;
+    size_t numberOfRounds;
 
     std::vector<int> earliestArrival;
 
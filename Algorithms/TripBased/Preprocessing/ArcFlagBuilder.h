@@ -0,0 +1,277 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../../../DataStructures/Container/Set.h"
+#include "../../../DataStructures/TripBased/Data.h"
+
+#include "../../../Helpers/Console/Progress.h"
+#include "../../../Helpers/MultiThreading.h"
+#include "../../../Helpers/String/String.h"
+#include "../../../Helpers/Timer.h"
+
+namespace TripBased {
+
+// Computes arc flags for the stop event graph. The stops are partitioned into cells by k-means on their coordinates.
+// Then, for every stop and every departure time at the stop, a one-to-all Trip-Based search is run that only boards
+// trips at the stop. Every journey that improves the arrival time at a stop for its number of trips is traced back
+// via parent pointers, and the cell of the stop is added to the flags of all shortcuts on the journey.
+// Every optimal journey of a query from an arbitrary vertex starts with a walk to the stop of its first trip, and the
+// remainder is optimal for departing at that stop, such that the flags of the cells of all stops that can walk to the
+// target are sufficient to answer the query.
+template<typename REACHED_INDEX>
+class ArcFlagBuilder {
+
+public:
+    using ReachedIndex = REACHED_INDEX;
+    static constexpr size_t MaxNumberOfCells = 64;
+
+private:
+    static constexpr u_int32_t NoParent = -1;
+
+    struct TripLabel {
+        TripLabel(const u_int32_t begin = 0, const u_int32_t end = 0, const u_int32_t parent = NoParent, const Edge edge = noEdge) :
+            begin(begin),
+            end(end),
+            parent(parent),
+            edge(edge) {
+        }
+        u_int32_t begin;
+        u_int32_t end;
+        u_int32_t parent; // Index of the trip label from which the trip was reached.
+        Edge edge; // The shortcut used to reach the trip, or noEdge for the initial trips.
+    };
+
+    // Search state of one thread.
+    class Search {
+
+    public:
+        Search(const Data& data, std::vector<u_int64_t>& arcFlags) :
+            data(data),
+            arcFlags(arcFlags),
+            reachedIndex(data),
+            arrivalTime(data.numberOfStops(), INFTY),
+            improvingLabel(data.numberOfStops(), NoParent),
+            improvedStops(data.numberOfStops()) {
+        }
+
+        inline void run(const StopId source, const int departureTime) noexcept {
+            clear();
+            for (const RAPTOR::RouteSegment& route : data.raptorData.routesContainingStop(source)) {
+                const TripId trip = data.getEarliestTrip(route, departureTime);
+                if (trip == noTripId) continue;
+                enqueue(trip, StopIndex(route.stopIndex));
+            }
+            scanTrips();
+        }
+
+    private:
+        inline void clear() noexcept {
+            reachedIndex.clear();
+            labels.clear();
+            currentRound = 0;
+            nextRound = 0;
+            for (const StopId stop : touchedStops) {
+                arrivalTime[stop] = INFTY;
+            }
+            touchedStops.clear();
+        }
+
+        inline void scanTrips() noexcept {
+            while (nextRound < labels.size()) {
+                currentRound = nextRound;
+                nextRound = labels.size();
+                for (u_int32_t l = currentRound; l < nextRound; l++) { // Find the stops that are improved in this round
+                    const TripLabel label = labels[l];
+                    for (StopEventId i(label.begin); i < label.end; i++) {
+                        const ArrivalEvent& arrivalEvent = data.arrivalEvents[i];
+                        if (arrivalTime[arrivalEvent.stop] <= arrivalEvent.arrivalTime) continue;
+                        if (arrivalTime[arrivalEvent.stop] == INFTY) touchedStops.emplace_back(arrivalEvent.stop);
+                        arrivalTime[arrivalEvent.stop] = arrivalEvent.arrivalTime;
+                        improvingLabel[arrivalEvent.stop] = l;
+                        improvedStops.insert(arrivalEvent.stop);
+                    }
+                }
+                for (const StopId stop : improvedStops) { // Flag the shortcuts of the improving journeys
+                    flagJourney(improvingLabel[stop], u_int64_t(1) << data.cellOfStop[stop]);
+                }
+                improvedStops.clear();
+                for (u_int32_t l = currentRound; l < nextRound; l++) { // Relax the transfers of each trip
+                    const Edge begin = data.stopEventGraph.beginEdgeFrom(Vertex(labels[l].begin));
+                    const Edge end = data.stopEventGraph.beginEdgeFrom(Vertex(labels[l].end));
+                    for (Edge edge = begin; edge < end; edge++) {
+                        enqueue(edge, l);
+                    }
+                }
+            }
+        }
+
+        inline void enqueue(const TripId trip, const StopIndex index) noexcept {
+            if (reachedIndex.alreadyReached(trip, index + 1)) return;
+            const StopEventId firstEvent = data.firstStopEventOfTrip[trip];
+            labels.emplace_back(firstEvent + index + 1, firstEvent + reachedIndex(trip));
+            reachedIndex.update(trip, index);
+        }
+
+        inline void enqueue(const Edge edge, const u_int32_t parent) noexcept {
+            const EdgeLabel& label = data.edgeLabels[edge];
+            if (reachedIndex.alreadyReached(label.trip, label.stopEvent - label.firstEvent)) return;
+            labels.emplace_back(label.stopEvent, label.firstEvent + reachedIndex(label.trip), parent, edge);
+            reachedIndex.update(label.trip, StopIndex(label.stopEvent - label.firstEvent));
+        }
+
+        inline void flagJourney(u_int32_t label, const u_int64_t flag) noexcept {
+            for (; labels[label].parent != NoParent; label = labels[label].parent) {
+                u_int64_t& flags = arcFlags[labels[label].edge];
+                u_int64_t oldFlags;
+                #pragma omp atomic read
+                oldFlags = flags;
+                if (oldFlags & flag) continue;
+                #pragma omp atomic
+                flags |= flag;
+            }
+        }
+
+    private:
+        const Data& data;
+        std::vector<u_int64_t>& arcFlags;
+
+        ReachedIndex reachedIndex;
+        std::vector<TripLabel> labels;
+        u_int32_t currentRound;
+        u_int32_t nextRound;
+
+        std::vector<int> arrivalTime;
+        std::vector<u_int32_t> improvingLabel;
+        IndexedSet<false, StopId> improvedStops;
+        std::vector<StopId> touchedStops;
+
+    };
+
+public:
+    ArcFlagBuilder(Data& data) :
+        data(data),
+        numberOfCells(0) {
+        AssertMsg(data.hasQueryLabels(), "The query labels of the Trip-Based data are missing!");
+    }
+
+    // Lloyd's algorithm with numberOfCells distinct random stops as initial centers.
+    inline void computeCells(const size_t numberOfCells, const int seed = 42, const size_t maxIterations = 100) noexcept {
+        Ensure(numberOfCells >= 1 && numberOfCells <= MaxNumberOfCells, "The number of cells must be between 1 and " << MaxNumberOfCells << "!");
+        Ensure(numberOfCells <= data.numberOfStops(), "There are only " << data.numberOfStops() << " stops!");
+        std::vector<StopId> stops;
+        for (const StopId stop : data.stops()) {
+            stops.emplace_back(stop);
+        }
+        std::mt19937 randomGenerator(seed);
+        std::shuffle(stops.begin(), stops.end(), randomGenerator);
+        std::vector<Geometry::Point> centers;
+        for (size_t i = 0; i < numberOfCells; i++) {
+            centers.emplace_back(getCoordinates(stops[i]));
+        }
+        this->numberOfCells = numberOfCells;
+        data.cellOfStop.assign(data.numberOfStops(), 0);
+        for (size_t iteration = 0; iteration < maxIterations; iteration++) {
+            bool changed = false;
+            for (const StopId stop : data.stops()) {
+                u_int8_t cell = 0;
+                for (size_t i = 1; i < numberOfCells; i++) {
+                    if ((getCoordinates(stop) - centers[i]).absSqured() < (getCoordinates(stop) - centers[cell]).absSqured()) cell = i;
+                }
+                changed |= (cell != data.cellOfStop[stop]);
+                data.cellOfStop[stop] = cell;
+            }
+            if (!changed && iteration > 0) break;
+            std::vector<Geometry::Point> sum(numberOfCells, Geometry::Point(Construct::XY, 0, 0));
+            std::vector<size_t> size(numberOfCells, 0);
+            for (const StopId stop : data.stops()) {
+                sum[data.cellOfStop[stop]] = sum[data.cellOfStop[stop]] + getCoordinates(stop);
+                size[data.cellOfStop[stop]]++;
+            }
+            for (size_t i = 0; i < numberOfCells; i++) {
+                if (size[i] > 0) centers[i] = sum[i] / size[i];
+            }
+        }
+    }
+
+    // The flags are collected with 64 bits per edge and stored in data with as few bytes per edge as the number of cells allows.
+    inline void computeFlags(const ThreadPinning& threadPinning = ThreadPinning(numberOfCores(), 1), const bool verbose = true) noexcept {
+        AssertMsg(numberOfCells > 0 && data.cellOfStop.size() == data.numberOfStops(), "The cells have not been computed!");
+        std::vector<u_int64_t> arcFlags(data.stopEventGraph.numEdges(), 0);
+        Progress progress(data.numberOfStops(), verbose);
+        size_t numberOfSearches = 0;
+        omp_set_num_threads(threadPinning.numberOfThreads);
+        #pragma omp parallel
+        {
+            threadPinning.pinThread();
+            Search search(data, arcFlags);
+            std::vector<int> departureTimes;
+
+            #pragma omp for schedule(dynamic,1) reduction(+:numberOfSearches)
+            for (size_t stop = 0; stop < data.numberOfStops(); stop++) {
+                departureTimes.clear();
+                for (const RAPTOR::RouteSegment& route : data.raptorData.routesContainingStop(StopId(stop))) {
+                    if (route.stopIndex + 1 == data.numberOfStopsInRoute(route.routeId)) continue;
+                    for (const TripId trip : data.tripsOfRoute(route.routeId)) {
+                        departureTimes.emplace_back(data.getStopEvent(trip, route.stopIndex).departureTime);
+                    }
+                }
+                std::sort(departureTimes.begin(), departureTimes.end());
+                departureTimes.erase(std::unique(departureTimes.begin(), departureTimes.end()), departureTimes.end());
+                for (const int departureTime : departureTimes) {
+                    search.run(StopId(stop), departureTime);
+                }
+                numberOfSearches += departureTimes.size();
+                progress++;
+            }
+        }
+        progress.finished();
+        data.setArcFlags(numberOfCells, arcFlags);
+        if (verbose) {
+            size_t numberOfFlags = 0;
+            size_t numberOfUnflaggedEdges = 0;
+            for (const u_int64_t flags : arcFlags) {
+                numberOfFlags += __builtin_popcountll(flags);
+                if (flags == 0) numberOfUnflaggedEdges++;
+            }
+            std::cout << "Ran " << String::prettyInt(numberOfSearches) << " searches" << std::endl;
+            std::cout << "Cells per edge: " << String::prettyDouble(numberOfFlags / static_cast<double>(data.stopEventGraph.numEdges()), 2) << std::endl;
+            std::cout << "Edges without flags: " << String::prettyInt(numberOfUnflaggedEdges) << " (" << String::percent(numberOfUnflaggedEdges / static_cast<double>(data.stopEventGraph.numEdges())) << ")" << std::endl;
+        }
+    }
+
+private:
+    inline const Geometry::Point& getCoordinates(const StopId stop) const noexcept {
+        return data.raptorData.stopData[stop].coordinates;
+    }
+
+private:
+    Data& data;
+    size_t numberOfCells;
+
+};
+
+}
@@ -20,12 +20,15 @@
 
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <vector>
 #include <string>
 
 
 #include "../../Dijkstra/Dijkstra.h"
+#include "../../RAPTOR/ULTRA/ShortcutSearchSchedule.h"
 
 #include "../../../Helpers/Meta.h"
 #include "../../../Helpers/Helpers.h"
@@ -86,21 +89,34 @@ public:
     };
 
 public:
-    ShortcutSearch(const Data& tripData, const int witnessTransferLimit) :
+    ShortcutSearch(const Data& tripData, const std::vector<Station>& stationOfStop, const int witnessTransferLimit) :
         tripData(tripData),
         data(tripData.raptorData),
-        stationOfStop(data.numberOfStops()),
+        stationOfStop(stationOfStop),
         sourceStation(),
         sourceDepartureTime(0),
+        directTransferArrivalLabels(data.transferGraph.numVertices()),
+        zeroTripsArrivalLabels(data.numberOfStops()),
+        oneTripArrivalLabels(data.transferGraph.numVertices()),
+        twoTripsArrivalLabels(data.transferGraph.numVertices()),
+        oneTripTransferParent(data.transferGraph.numVertices(), noStopEvent),
+        twoTripsRouteParent(data.numberOfStops(), noStop),
         twoTripsRouteParentEvent(tripData.numberOfStopEvents()),
         shortcutCandidatesInQueue(0),
         shortcutDestinationCandidates(data.numberOfStopEvents()),
         routesServingUpdatedStops(data.numberOfRoutes()),
         stopsUpdatedByRoute(data.numberOfStops()),
         stopsUpdatedByTransfer(data.numberOfStops()),
+        touchedVertices(data.transferGraph.numVertices()),
         witnessTransferLimit(witnessTransferLimit),
         earliestDepartureTime(data.getMinDepartureTime()) {
         AssertMsg(data.hasImplicitBufferTimes(), "Shortcut search requires implicit departure buffer times!");
+        AssertMsg(stationOfStop.size() == data.numberOfStops(), "Station map has " << stationOfStop.size() << " entries, but there are " << data.numberOfStops() << " stops!");
+    }
+
+    // Groups stops that are connected by transfers of length 0. Computed once and shared by all threads.
+    inline static std::vector<Station> ComputeStationOfStop(const RAPTOR::Data& data) noexcept {
+        std::vector<Station> stationOfStop(data.numberOfStops());
         Dijkstra<TransferGraph, false> dijkstra(data.transferGraph);
         for (const StopId stop : data.stops()) {
             dijkstra.run(stop, noVertex, [&](const Vertex u) {
@@ -110,6 +126,7 @@ public:
                 return data.transferGraph.get(TravelTime, edge) > 0;
             });
         }
+        return stationOfStop;
     }
 
     inline void run(const StopId source, const int minTime, const int maxTime) noexcept {
@@ -125,6 +142,13 @@ public:
         return shortcuts;
     }
 
+    // Departure times at the stops of the source station within [minTime, maxTime] in descending order. Every one of
+    // them starts an iteration of run(source, minTime, maxTime), so their number estimates the cost of the source.
+    inline std::vector<int> getDepartureTimes(const StopId source, const int minTime, const int maxTime) const noexcept {
+        if (stationOfStop[source].representative != source) return std::vector<int>();
+        return RAPTOR::ULTRA::ShortcutSearchSchedule::GetDepartureTimes(data, stationOfStop[source].stops, std::max(minTime, earliestDepartureTime), maxTime);
+    }
+
 private:
     inline void setSource(const StopId sourceStop) noexcept {
         AssertMsg(directTransferQueue.empty(), "Queue for round 0 is not empty!");
@@ -151,6 +175,7 @@ private:
 
         sourceDepartureTime = label.departureTime;
         for (const StopId stop : sourceStation.stops) {
+            touchedVertices.insert(stop);
             zeroTripsArrivalLabels[stop].arrivalTime = label.departureTime;
             oneTripArrivalLabels[stop].arrivalTime = label.departureTime;
             twoTripsArrivalLabels[stop].arrivalTime = label.departureTime;
@@ -212,19 +237,21 @@ private:
     inline void clear() noexcept {
         sourceStation = Station();
 
-        std::vector<ArrivalLabel>(data.transferGraph.numVertices()).swap(directTransferArrivalLabels);
         stopsReachedByDirectTransfer.clear();
-
-        std::vector<ArrivalLabel>(data.numberOfStops()).swap(zeroTripsArrivalLabels);
-
         oneTripQueue.clear();
-        std::vector<ArrivalLabel>(data.transferGraph.numVertices()).swap(oneTripArrivalLabels);
-
         twoTripsQueue.clear();
-        std::vector<ArrivalLabel>(data.transferGraph.numVertices()).swap(twoTripsArrivalLabels);
 
-        std::vector<StopEventId>(data.transferGraph.numVertices(), noStopEvent).swap(oneTripTransferParent);
-        std::vector<StopId>(data.numberOfStops(), noStop).swap(twoTripsRouteParent);
+        //Only the labels written during the previous source are reset, all others still hold their default values.
+        for (const Vertex vertex : touchedVertices) {
+            directTransferArrivalLabels[vertex] = ArrivalLabel();
+            oneTripArrivalLabels[vertex] = ArrivalLabel();
+            twoTripsArrivalLabels[vertex] = ArrivalLabel();
+            oneTripTransferParent[vertex] = noStopEvent;
+            if (!data.isStop(vertex)) continue;
+            zeroTripsArrivalLabels[vertex] = ArrivalLabel();
+            twoTripsRouteParent[vertex] = noStop;
+        }
+        touchedVertices.clear();
 
         shortcutCandidatesInQueue = 0;
         shortcutDestinationCandidates.clear();
@@ -319,6 +346,7 @@ private:
     }
 
     inline void initialDijkstra() noexcept {
+        touchedVertices.insert(sourceStation.representative);
         directTransferArrivalLabels[sourceStation.representative].arrivalTime = 0;
         directTransferQueue.update(&(directTransferArrivalLabels[sourceStation.representative]));
         while (!directTransferQueue.empty()) {
@@ -328,6 +356,7 @@ private:
                 const Vertex neighborVertex = data.transferGraph.get(ToVertex, edge);
                 const int newArrivalTime = currentLabel->arrivalTime + data.transferGraph.get(TravelTime, edge);
                 if (newArrivalTime < directTransferArrivalLabels[neighborVertex].arrivalTime) {
+                    touchedVertices.insert(neighborVertex);
                     directTransferArrivalLabels[neighborVertex].arrivalTime = newArrivalTime;
                     directTransferQueue.update(&(directTransferArrivalLabels[neighborVertex]));
                 }
@@ -474,6 +503,7 @@ private:
     inline void arrivalByRoute1(const StopId stop, const int arrivalTime, const StopId parent, const StopEventId arrivalStopEvent) noexcept {
         //Shortcut origin candidates are marked here (and only here).
         //Once added, they cannot be dominated by witnesses during the first route scan, since witnesses are scanned first.
+        touchedVertices.insert(stop);
         if (stationOfStop[parent].representative == sourceStation.representative) {
             oneTripTransferParent[stop] = arrivalStopEvent;
         } else {
@@ -495,6 +525,7 @@ private:
 
     inline void arrivalByRoute2(const StopId stop, const int arrivalTime, const StopId parent, const StopEventId parentStopEvent) noexcept {
         //Mark journey as candidate or witness
+        touchedVertices.insert(stop);
         if (oneTripTransferParent[parent] != noStopEvent) {
             twoTripsRouteParent[stop] = parent;
             twoTripsRouteParentEvent[stop] = parentStopEvent;
@@ -509,6 +540,7 @@ private:
     }
 
     inline void arrivalByEdge0(const Vertex vertex, const int arrivalTime) noexcept {
+        touchedVertices.insert(vertex);
         zeroTripsArrivalLabels[vertex].arrivalTime = arrivalTime;
         if (oneTripArrivalLabels[vertex].arrivalTime > arrivalTime) {
             oneTripArrivalLabels[vertex].arrivalTime = arrivalTime;
@@ -525,6 +557,7 @@ private:
     }
 
     inline void arrivalByEdge1(const Vertex vertex, const int arrivalTime, const Vertex parent) noexcept {
+        touchedVertices.insert(vertex);
         if (isShortcutCandidate(vertex)) shortcutCandidatesInQueue--;
         if (oneTripTransferParent[parent] != noStopEvent) shortcutCandidatesInQueue++;
         oneTripTransferParent[vertex] = oneTripTransferParent[parent];
@@ -539,6 +572,7 @@ private:
     }
 
     inline void arrivalByEdge2(const Vertex vertex, const int arrivalTime) noexcept {
+        touchedVertices.insert(vertex);
         twoTripsArrivalLabels[vertex].arrivalTime = arrivalTime;
         twoTripsQueue.update(&(twoTripsArrivalLabels[vertex]));
         if (!data.isStop(vertex)) return;
@@ -562,7 +596,7 @@ private:
 private:
     const Data& tripData;
     const RAPTOR::Data& data;
-    std::vector<Station> stationOfStop;
+    const std::vector<Station>& stationOfStop;
 
     Station sourceStation;
     int sourceDepartureTime;
@@ -595,6 +629,9 @@ private:
     IndexedSet<false, StopId> stopsUpdatedByRoute;
     IndexedSet<false, StopId> stopsUpdatedByTransfer;
 
+    //Vertices whose labels differ from the default values and have to be reset for the next source
+    IndexedSet<false, Vertex> touchedVertices;
+
     int witnessTransferLimit;
 
     int earliestDepartureTime;
@@ -20,7 +20,12 @@
 
 #pragma once
 
+#include <cstdio>
+#include <vector>
+
 #include "../../../Helpers/MultiThreading.h"
+#include "../../../Helpers/Timer.h"
+#include "../../../Helpers/String/String.h"
 #include "../../../Helpers/Console/Progress.h"
 #include "../../../DataStructures/TripBased/Data.h"
 
@@ -53,25 +58,159 @@ private:
         int timeStamp;
     };
 
+    // Append-only sequence of the edges computed by one thread. If a spill threshold is given, the buffered edges are
+    // moved to an anonymous temporary file whenever the buffer reaches the threshold, such that the memory used by the
+    // thread does not grow with the number of edges.
+    class EdgeStream {
+
+    public:
+        EdgeStream(const size_t spillThreshold = 0) :
+            spillThreshold(spillThreshold),
+            spillFile(nullptr),
+            numberOfSpilledEdges(0) {
+        }
+        EdgeStream(const EdgeStream&) = delete;
+        EdgeStream& operator=(const EdgeStream&) = delete;
+
+        ~EdgeStream() {
+            clear();
+        }
+
+        inline void append(const Vertex* begin, const Vertex* end) noexcept {
+            buffer.insert(buffer.end(), begin, end);
+            if (spillThreshold > 0 && buffer.size() >= spillThreshold) spill();
+        }
+
+        // Calls function for every edge in the order in which the edges were appended.
+        template<typename FUNCTION>
+        inline void forEach(const FUNCTION& function) noexcept {
+            if (spillFile) {
+                std::rewind(spillFile);
+                std::vector<Vertex> chunk(spillThreshold);
+                for (size_t remaining = numberOfSpilledEdges; remaining > 0;) {
+                    const size_t chunkSize = std::min(remaining, chunk.size());
+                    Ensure(std::fread(chunk.data(), sizeof(Vertex), chunkSize, spillFile) == chunkSize, "Could not read spilled edges!");
+                    for (size_t i = 0; i < chunkSize; i++) {
+                        function(chunk[i]);
+                    }
+                    remaining -= chunkSize;
+                }
+            }
+            for (const Vertex vertex : buffer) {
+                function(vertex);
+            }
+        }
+
+        inline void clear() noexcept {
+            std::vector<Vertex>().swap(buffer);
+            if (spillFile) std::fclose(spillFile);
+            spillFile = nullptr;
+            numberOfSpilledEdges = 0;
+        }
+
+        inline size_t size() const noexcept {
+            return numberOfSpilledEdges + buffer.size();
+        }
+
+        inline long long spilledBytes() const noexcept {
+            return numberOfSpilledEdges * sizeof(Vertex);
+        }
+
+        inline long long byteSize() const noexcept {
+            return Vector::byteSize(buffer);
+        }
+
+    private:
+        inline void spill() noexcept {
+            if (!spillFile) spillFile = std::tmpfile();
+            Ensure(spillFile != nullptr, "Could not create a temporary file for spilling edges!");
+            Ensure(std::fwrite(buffer.data(), sizeof(Vertex), buffer.size(), spillFile) == buffer.size(), "Could not spill edges!");
+            numberOfSpilledEdges += buffer.size();
+            buffer.clear();
+        }
+
+    private:
+        size_t spillThreshold;
+        std::vector<Vertex> buffer;
+        FILE* spillFile;
+        size_t numberOfSpilledEdges;
+
+    };
+
 public:
-    StopEventGraphBuilder(const Data& data) :
+    StopEventGraphBuilder(const Data& data, const size_t spillThreshold = 0) :
         data(data),
-        edges(data.numberOfStopEvents()),
+        edgeStream(spillThreshold),
         labels(data.numberOfStops()),
         timeStamp(0) {
     }
 
 public:
+    // Computes the transfers of all stop events of the trip and appends them to the thread-local edge stream.
+    // The out-degrees are written to outDegree[event + 1], which is race free since every trip is handled by one thread.
+    inline void computeEdges(const TripId trip, std::vector<Edge>& outDegree) noexcept {
+        scanTrip(trip);
+        reduceTransfers(trip);
+        const StopEventId firstEvent = data.firstStopEventOfTrip[trip];
+        for (StopIndex i = StopIndex(0); i < data.numberOfStopsInTrip(trip); i++) {
+            outDegree[firstEvent + i + 1] = Edge(numberOfEdges[i]);
+            if (numberOfEdges[i] == 0) continue;
+            const Vertex* edges = candidates.data() + firstCandidate[i];
+            edgeStream.append(edges, edges + numberOfEdges[i]);
+        }
+        tripBuffer.emplace_back(trip);
+    }
+
+    // Copies the streamed edges to their final positions in the CSR arrays and releases the buffers.
+    inline void writeEdges(SimpleStaticGraph& stopEventGraph) noexcept {
+        std::vector<Vertex>& toVertex = stopEventGraph.get(ToVertex);
+        size_t tripIndex = 0;
+        Edge edge = noEdge;
+        Edge endEdge = noEdge;
+        if (!tripBuffer.empty()) nextTrip(stopEventGraph, tripIndex, edge, endEdge);
+        edgeStream.forEach([&](const Vertex vertex) {
+            while (edge == endEdge) {
+                tripIndex++;
+                nextTrip(stopEventGraph, tripIndex, edge, endEdge);
+            }
+            toVertex[edge++] = vertex;
+        });
+        edgeStream.clear();
+        std::vector<TripId>().swap(tripBuffer);
+    }
+
+    inline long long byteSize() const noexcept {
+        long long result = Vector::byteSize(labels);
+        result += edgeStream.byteSize();
+        result += Vector::byteSize(tripBuffer);
+        result += Vector::byteSize(candidates);
+        result += Vector::byteSize(firstCandidate);
+        result += Vector::byteSize(numberOfEdges);
+        result += Vector::byteSize(transfers);
+        return result;
+    }
+
+    inline long long spilledBytes() const noexcept {
+        return edgeStream.spilledBytes();
+    }
+
     inline void scanTrip(const TripId trip) noexcept {
+        const size_t tripLength = data.numberOfStopsInTrip(trip);
+        candidates.clear();
+        firstCandidate.resize(tripLength + 1);
+        numberOfEdges.assign(tripLength, 0);
+        firstCandidate[0] = 0;
         const StopId* stops = data.stopArrayOfTrip(trip);
         const StopEventId firstEvent = data.firstStopEventOfTrip[trip];
-        for (StopIndex i = StopIndex(1); i < data.numberOfStopsInTrip(trip); i++) {
+        for (StopIndex i = StopIndex(1); i < tripLength; i++) {
+            firstCandidate[i] = candidates.size();
             const int arrivalTime = data.raptorData.stopEvents[firstEvent + i].arrivalTime;
             scanRoutes(trip, i, stops[i], arrivalTime);
             for (const Edge edge : data.raptorData.transferGraph.edgesFrom(stops[i])) {
                 scanRoutes(trip, i, StopId(data.raptorData.transferGraph.get(ToVertex, edge)), arrivalTime + data.raptorData.transferGraph.get(TravelTime, edge));
             }
         }
+        firstCandidate[tripLength] = candidates.size();
     }
 
     inline void scanRoutes(const TripId trip, const StopIndex i, const StopId stop, const int arrivalTime) noexcept  {
@@ -81,7 +220,7 @@ public:
             if (other == noTripId) continue;
             if ((route.routeId == originalRoute) && (other >= trip) && (route.stopIndex >= i)) continue;
             if (isUTransfer(trip, i, other, route.stopIndex)) continue;
-            edges[data.firstStopEventOfTrip[trip] + i].emplace_back(Vertex(data.firstStopEventOfTrip[other] + route.stopIndex));
+            candidates.emplace_back(Vertex(data.firstStopEventOfTrip[other] + route.stopIndex));
         }
     }
 
@@ -104,21 +243,21 @@ public:
                 labels[data.raptorData.transferGraph.get(ToVertex, edge)].update(timeStamp, arrivalTime + data.raptorData.transferGraph.get(TravelTime, edge));
             }
 
-            const Vertex stopEventVertex = Vertex(data.firstStopEventOfTrip[trip] + i);
-            if (edges[stopEventVertex].empty()) continue;
-            std::sort(edges[stopEventVertex].begin(), edges[stopEventVertex].end(), [&](const Vertex a, const Vertex b){
+            // The candidates of stop index i are reduced in place, the kept ones are written to the front of their range.
+            const auto stopEventEdges = candidates.begin() + firstCandidate[i];
+            const auto stopEventEdgesEnd = candidates.begin() + firstCandidate[i + 1];
+            if (stopEventEdges == stopEventEdgesEnd) continue;
+            std::sort(stopEventEdges, stopEventEdgesEnd, [&](const Vertex a, const Vertex b){
                 return data.raptorData.stopEvents[a].arrivalTime < data.raptorData.stopEvents[b].arrivalTime;
             });
-            std::vector<Vertex> transfers;
-            transfers.emplace_back(edges[stopEventVertex][0]);
-            for (size_t i = 0; i < edges[stopEventVertex].size(); i++) {
-                if (transfers.back() != edges[stopEventVertex][i]) {
-                    transfers.emplace_back(edges[stopEventVertex][i]);
+            transfers.clear();
+            transfers.emplace_back(*stopEventEdges);
+            for (auto candidate = stopEventEdges; candidate != stopEventEdgesEnd; candidate++) {
+                if (transfers.back() != *candidate) {
+                    transfers.emplace_back(*candidate);
                 }
             }
-            edges[stopEventVertex].clear();
 
-            std::vector<Edge> deleteTransfers;
             for (const Vertex transferTarget : transfers) {
                 bool keep = false;
                 const StopIndex transferTargetIndex = data.indexOfStopEvent[transferTarget];
@@ -142,21 +281,34 @@ public:
                         }
                     }
                 }
-                if (keep) edges[stopEventVertex].emplace_back(transferTarget);
-            }
-            std::vector<Vertex> keptTransfers;
-            keptTransfers.reserve(edges[stopEventVertex].size());
-            for (const Vertex v : edges[stopEventVertex]) {
-                keptTransfers.emplace_back(v);
+                if (keep) stopEventEdges[numberOfEdges[i]++] = transferTarget;
             }
-            edges[stopEventVertex].swap(keptTransfers);
+            std::sort(stopEventEdges, stopEventEdges + numberOfEdges[i]);
         }
     }
 
+private:
+    inline void nextTrip(const SimpleStaticGraph& stopEventGraph, const size_t tripIndex, Edge& edge, Edge& endEdge) const noexcept {
+        AssertMsg(tripIndex < tripBuffer.size(), "More edges were streamed than the trips have!");
+        const Vertex firstEvent = Vertex(data.firstStopEventOfTrip[tripBuffer[tripIndex]]);
+        const Vertex lastEvent = Vertex(firstEvent + data.numberOfStopsInTrip(tripBuffer[tripIndex]) - 1);
+        edge = stopEventGraph.beginEdgeFrom(firstEvent);
+        endEdge = stopEventGraph.endEdgeFrom(lastEvent);
+    }
+
 public:
     const Data& data;
 
-    std::vector<std::vector<Vertex>> edges;
+    // Transfer candidates of the current trip, grouped by stop index starting at firstCandidate. After the reduction,
+    // the first numberOfEdges entries of each group are the edges of the corresponding stop event.
+    std::vector<Vertex> candidates;
+    std::vector<size_t> firstCandidate;
+    std::vector<size_t> numberOfEdges;
+    std::vector<Vertex> transfers;
+
+    // Edges of all trips handled by this builder, in the order of tripBuffer
+    EdgeStream edgeStream;
+    std::vector<TripId> tripBuffer;
 
     std::vector<StopLabel> labels;
     int timeStamp;
@@ -165,30 +317,31 @@ public:
 
 inline void ComputeStopEventGraph(Data& data) noexcept {
     Progress progress(data.numberOfTrips());
-    SimpleEdgeList stopEventGraph;
-    stopEventGraph.addVertices(data.numberOfStopEvents());
+    std::vector<Edge> beginOut(data.numberOfStopEvents() + 1, Edge(0));
 
     StopEventGraphBuilder builder(data);
     for (const TripId trip : data.trips()) {
-        builder.scanTrip(trip);
-        builder.reduceTransfers(trip);
+        builder.computeEdges(trip, beginOut);
         progress++;
     }
-    for (const Vertex from : stopEventGraph.vertices()) {
-        for (const Vertex to : builder.edges[from]) {
-            stopEventGraph.addEdge(from, to);
-        }
+    for (size_t i = 1; i < beginOut.size(); i++) {
+        beginOut[i] += beginOut[i - 1];
     }
 
-    Graph::move(std::move(stopEventGraph), data.stopEventGraph);
-    data.stopEventGraph.sortEdges(ToVertex);
+    data.stopEventGraph.setAdjacencyStructure(std::move(beginOut));
+    builder.writeEdges(data.stopEventGraph);
     progress.finished();
 }
 
-inline void ComputeStopEventGraph(Data& data, const int numberOfThreads, const int pinMultiplier = 1) noexcept {
-    Progress progress(data.numberOfTrips());
-    SimpleEdgeList stopEventGraph;
-    stopEventGraph.addVertices(data.numberOfStopEvents());
+inline void ComputeStopEventGraph(Data& data, const int numberOfThreads, const int pinMultiplier = 1, const size_t spillThreshold = 0, const bool verbose = true) noexcept {
+    Progress progress(data.numberOfTrips(), verbose);
+    Timer timer;
+    std::vector<Edge> beginOut(data.numberOfStopEvents() + 1, Edge(0));
+    std::vector<Edge> blockSum;
+    std::vector<long long> bufferSize(numberOfThreads, 0);
+    std::vector<long long> spilledSize(numberOfThreads, 0);
+    double scanTime = 0;
+    double prefixSumTime = 0;
 
     const int numCores = numberOfCores();
 
@@ -199,30 +352,39 @@ inline void ComputeStopEventGraph(Data& data, const int numberOfThreads, const i
         pinThreadToCoreId((threadId * pinMultiplier) % numCores);
         AssertMsg(omp_get_num_threads() == numberOfThreads, "Number of threads is " << omp_get_num_threads() << ", but should be " << numberOfThreads << "!");
 
-        StopEventGraphBuilder builder(data);
+        StopEventGraphBuilder builder(data, spillThreshold);
         const size_t numberOfTrips = data.numberOfTrips();
 
         #pragma omp for schedule(dynamic,1)
         for (size_t i = 0; i < numberOfTrips; i++) {
-            const TripId trip = TripId(i);
-            builder.scanTrip(trip);
-            builder.reduceTransfers(trip);
+            builder.computeEdges(TripId(i), beginOut);
             progress++;
         }
-
-        #pragma omp critical
+        bufferSize[threadId] = builder.byteSize();
+        spilledSize[threadId] = builder.spilledBytes();
+
+        #pragma omp barrier
+        #pragma omp single
+        scanTime = timer.elapsedMilliseconds();
+        parallelPrefixSum(beginOut, blockSum);
+        #pragma omp single
         {
-            for (const Vertex from : stopEventGraph.vertices()) {
-                for (const Vertex to : builder.edges[from]) {
-                    stopEventGraph.addEdge(from, to);
-                }
-            }
+            prefixSumTime = timer.elapsedMilliseconds() - scanTime;
+            data.stopEventGraph.setAdjacencyStructure(std::move(beginOut));
         }
+        builder.writeEdges(data.stopEventGraph);
     }
-
-    Graph::move(std::move(stopEventGraph), data.stopEventGraph);
-    data.stopEventGraph.sortEdges(ToVertex);
     progress.finished();
+
+    if (verbose) {
+        const double writeTime = timer.elapsedMilliseconds() - scanTime - prefixSumTime;
+        std::cout << "Built stop event graph with " << String::prettyInt(data.stopEventGraph.numEdges()) << " edges using " << numberOfThreads << " threads in " << String::msToString(timer.elapsedMilliseconds()) << std::endl;
+        std::cout << "   Scanning trips: " << String::msToString(scanTime) << ", prefix sum: " << String::msToString(prefixSumTime) << ", writing edges: " << String::msToString(writeTime) << std::endl;
+        std::cout << "   Peak thread-local memory: " << String::bytesToString(Vector::sum(bufferSize)) << " (max. " << String::bytesToString(Vector::max(bufferSize)) << " per thread)" << std::endl;
+        if (spillThreshold > 0) {
+            std::cout << "   Spilled to temporary files: " << String::bytesToString(Vector::sum(spilledSize)) << std::endl;
+        }
+    }
 }
 
 }
@@ -0,0 +1,231 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../../../Helpers/Helpers.h"
+#include "../../../Helpers/String/String.h"
+#include "../../../DataStructures/TripBased/Data.h"
+#include "../../../DataStructures/TripBased/Shortcut.h"
+
+namespace TripBased {
+
+// Matches the trips of two versions of a timetable with the same stops and transfer graph. A trip is unchanged if the
+// new timetable contains a trip with the same stop sequence and the same arrival and departure times. If a period is
+// given (e.g. one day for a rolling window of days), the remaining new trips are matched to old trips shifted by the
+// period, such that the shortcuts of periodic trips can be instantiated instead of recomputed.
+class TimetableDiff {
+
+public:
+    TimetableDiff(const Data& oldData, const Data& newData, const int period = 0) :
+        oldData(oldData),
+        newData(newData),
+        period(period),
+        newTripOfOldTrip(oldData.numberOfTrips(), noTripId),
+        oldTripOfNewTrip(newData.numberOfTrips(), noTripId),
+        shiftedTripOfOldTrip(oldData.numberOfTrips(), noTripId),
+        oldTripOfShiftedTrip(newData.numberOfTrips(), noTripId) {
+        Ensure(oldData.numberOfStops() == newData.numberOfStops(), "The old timetable has " << oldData.numberOfStops() << " stops, but the new one has " << newData.numberOfStops() << "!");
+        Ensure(haveEqualTransferGraphs(), "The transfer graphs of the old and the new timetable differ!");
+        matchTrips(0, newTripOfOldTrip, oldTripOfNewTrip);
+        if (period != 0) matchTrips(period, shiftedTripOfOldTrip, oldTripOfShiftedTrip);
+    }
+
+    inline StopEventId getNewStopEvent(const StopEventId oldStopEvent) const noexcept {
+        return getNewStopEvent(oldStopEvent, newTripOfOldTrip);
+    }
+
+    // Shortcuts of the old stop event graph between unchanged trips, with the stop events of the new timetable. If a
+    // period is given, the shortcuts between old trips that reappear shifted by the period are instantiated as well.
+    inline std::vector<Shortcut> getUnchangedShortcuts() const noexcept {
+        std::vector<Shortcut> shortcuts;
+        addShortcuts(newTripOfOldTrip, shortcuts);
+        if (period != 0) addShortcuts(shiftedTripOfOldTrip, shortcuts);
+        return shortcuts;
+    }
+
+    // Departure time ranges of the shortcut searches that may use a removed or added trip. A search departing more than
+    // horizon seconds before the first departure of a trip is assumed not to reach it. No finite horizon guarantees this:
+    // since the journeys of a search may wait arbitrarily long between two trips, a removed witness can invalidate the
+    // shortcuts of a search departing earlier. The caller has to verify the result if it must be exact. Shifted trips are
+    // not added.
+    inline std::vector<std::pair<int, int>> getAffectedDepartureTimes(const int horizon) const noexcept {
+        std::vector<std::pair<int, int>> ranges;
+        for (const TripId trip : oldData.trips()) {
+            if (isTrip(newTripOfOldTrip[trip])) continue;
+            ranges.emplace_back(tripTimes(oldData, trip, horizon));
+        }
+        for (const TripId trip : newData.trips()) {
+            if (!isAddedTrip(trip)) continue;
+            ranges.emplace_back(tripTimes(newData, trip, horizon));
+        }
+        std::sort(ranges.begin(), ranges.end());
+        std::vector<std::pair<int, int>> result;
+        for (const std::pair<int, int>& range : ranges) {
+            if (!result.empty() && range.first <= result.back().second) {
+                result.back().second = std::max(result.back().second, range.second);
+            } else {
+                result.emplace_back(range);
+            }
+        }
+        return result;
+    }
+
+    // Twice the longest trip duration plus the witness limit, which covers all candidate journeys with two trips that
+    // do not wait between the trips. It is a heuristic, not a bound (see getAffectedDepartureTimes()).
+    inline int getDefaultHorizon(const int witnessTransferLimit) const noexcept {
+        return 2 * std::max(maxTripDuration(oldData), maxTripDuration(newData)) + witnessTransferLimit;
+    }
+
+    inline void printInfo() const noexcept {
+        size_t numberOfUnchangedTrips = 0;
+        size_t numberOfShiftedTrips = 0;
+        size_t numberOfAddedTrips = 0;
+        for (const TripId trip : newData.trips()) {
+            if (isTrip(oldTripOfNewTrip[trip])) {
+                numberOfUnchangedTrips++;
+            } else if (isTrip(oldTripOfShiftedTrip[trip])) {
+                numberOfShiftedTrips++;
+            } else {
+                numberOfAddedTrips++;
+            }
+        }
+        std::cout << "Timetable diff:" << std::endl;
+        std::cout << "   Unchanged trips:          " << std::setw(12) << String::prettyInt(numberOfUnchangedTrips) << std::endl;
+        if (period != 0) {
+            std::cout << "   Trips shifted by period:  " << std::setw(12) << String::prettyInt(numberOfShiftedTrips) << std::endl;
+        }
+        std::cout << "   Removed trips:            " << std::setw(12) << String::prettyInt(oldData.numberOfTrips() - numberOfUnchangedTrips) << std::endl;
+        std::cout << "   Added trips:              " << std::setw(12) << String::prettyInt(numberOfAddedTrips) << std::endl;
+    }
+
+private:
+    // Matches every new trip to an unmatched old trip that equals it after shifting it by timeOffset.
+    inline void matchTrips(const int timeOffset, std::vector<TripId>& newTripOf, std::vector<TripId>& oldTripOf) noexcept {
+        std::unordered_map<size_t, std::vector<TripId>> oldTripsByHash;
+        for (const TripId trip : oldData.trips()) {
+            oldTripsByHash[tripHash(oldData, trip, timeOffset)].emplace_back(trip);
+        }
+        for (const TripId newTrip : newData.trips()) {
+            const auto candidates = oldTripsByHash.find(tripHash(newData, newTrip, 0));
+            if (candidates == oldTripsByHash.end()) continue;
+            for (const TripId oldTrip : candidates->second) {
+                if (isTrip(newTripOf[oldTrip]) || !areEqualTrips(oldTrip, newTrip, timeOffset)) continue;
+                newTripOf[oldTrip] = newTrip;
+                oldTripOf[newTrip] = oldTrip;
+                break;
+            }
+        }
+    }
+
+    inline StopEventId getNewStopEvent(const StopEventId oldStopEvent, const std::vector<TripId>& newTripOf) const noexcept {
+        const TripId newTrip = newTripOf[oldData.tripOfStopEvent[oldStopEvent]];
+        if (!isTrip(newTrip)) return noStopEvent;
+        return StopEventId(newData.firstStopEventOfTrip[newTrip] + oldData.indexOfStopEvent[oldStopEvent]);
+    }
+
+    inline void addShortcuts(const std::vector<TripId>& newTripOf, std::vector<Shortcut>& shortcuts) const noexcept {
+        for (const auto [edge, from] : oldData.stopEventGraph.edgesWithFromVertex()) {
+            const StopEventId origin = getNewStopEvent(StopEventId(from), newTripOf);
+            if (origin == noStopEvent) continue;
+            const StopEventId destination = getNewStopEvent(StopEventId(oldData.stopEventGraph.get(ToVertex, edge)), newTripOf);
+            if (destination == noStopEvent) continue;
+            shortcuts.emplace_back(origin, destination);
+        }
+    }
+
+    inline static size_t tripHash(const Data& data, const TripId trip, const int timeOffset) noexcept {
+        size_t hash = data.numberOfStopsInTrip(trip);
+        const StopId* stops = data.stopArrayOfTrip(trip);
+        const RAPTOR::StopEvent* events = data.eventArrayOfTrip(trip);
+        for (size_t i = 0; i < data.numberOfStopsInTrip(trip); i++) {
+            hash = (hash * 1000003) ^ size_t(stops[i]);
+            hash = (hash * 1000003) ^ size_t(events[i].arrivalTime + timeOffset);
+            hash = (hash * 1000003) ^ size_t(events[i].departureTime + timeOffset);
+        }
+        return hash;
+    }
+
+    inline bool areEqualTrips(const TripId oldTrip, const TripId newTrip, const int timeOffset) const noexcept {
+        if (oldData.numberOfStopsInTrip(oldTrip) != newData.numberOfStopsInTrip(newTrip)) return false;
+        const StopId* oldStops = oldData.stopArrayOfTrip(oldTrip);
+        const StopId* newStops = newData.stopArrayOfTrip(newTrip);
+        const RAPTOR::StopEvent* oldEvents = oldData.eventArrayOfTrip(oldTrip);
+        const RAPTOR::StopEvent* newEvents = newData.eventArrayOfTrip(newTrip);
+        for (size_t i = 0; i < oldData.numberOfStopsInTrip(oldTrip); i++) {
+            if (oldStops[i] != newStops[i]) return false;
+            if (oldEvents[i].arrivalTime + timeOffset != newEvents[i].arrivalTime) return false;
+            if (oldEvents[i].departureTime + timeOffset != newEvents[i].departureTime) return false;
+        }
+        return true;
+    }
+
+    inline bool haveEqualTransferGraphs() const noexcept {
+        const TransferGraph& oldGraph = oldData.raptorData.transferGraph;
+        const TransferGraph& newGraph = newData.raptorData.transferGraph;
+        if (oldGraph.numVertices() != newGraph.numVertices() || oldGraph.numEdges() != newGraph.numEdges()) return false;
+        for (const Vertex vertex : oldGraph.vertices()) {
+            if (oldGraph.beginEdgeFrom(vertex) != newGraph.beginEdgeFrom(vertex)) return false;
+        }
+        return (oldGraph.get(ToVertex) == newGraph.get(ToVertex)) && (oldGraph.get(TravelTime) == newGraph.get(TravelTime));
+    }
+
+    inline static std::pair<int, int> tripTimes(const Data& data, const TripId trip, const int horizon) noexcept {
+        const RAPTOR::StopEvent* events = data.eventArrayOfTrip(trip);
+        return std::make_pair(events[0].departureTime - horizon, events[data.numberOfStopsInTrip(trip) - 1].arrivalTime);
+    }
+
+    inline static int maxTripDuration(const Data& data) noexcept {
+        int result = 0;
+        for (const TripId trip : data.trips()) {
+            const std::pair<int, int> times = tripTimes(data, trip, 0);
+            result = std::max(result, times.second - times.first);
+        }
+        return result;
+    }
+
+    inline bool isAddedTrip(const TripId newTrip) const noexcept {
+        return !isTrip(oldTripOfNewTrip[newTrip]) && !isTrip(oldTripOfShiftedTrip[newTrip]);
+    }
+
+    inline bool isTrip(const TripId trip) const noexcept {
+        return trip != noTripId;
+    }
+
+private:
+    const Data& oldData;
+    const Data& newData;
+    const int period;
+
+    std::vector<TripId> newTripOfOldTrip;
+    std::vector<TripId> oldTripOfNewTrip;
+    std::vector<TripId> shiftedTripOfOldTrip;
+    std::vector<TripId> oldTripOfShiftedTrip;
+
+};
+
+}
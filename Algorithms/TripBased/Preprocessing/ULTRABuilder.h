@@ -21,14 +21,19 @@
 #pragma once
 
 #include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "../../../DataStructures/TripBased/Data.h"
 #include "../../../DataStructures/RAPTOR/Data.h"
 #include "../../../Helpers/MultiThreading.h"
 #include "../../../Helpers/Timer.h"
 #include "../../../Helpers/Console/Progress.h"
+#include "../../../Helpers/IO/Serialization.h"
 
 #include "ShortcutSearch.h"
+#include "../../RAPTOR/ULTRA/ShortcutSearchSchedule.h"
 
 namespace TripBased {
 
@@ -39,64 +44,232 @@ public:
     inline static constexpr bool Debug = DEBUG;
     using Type = ULTRABuilder<Debug>;
 
+public:
+    using Job = RAPTOR::ULTRA::ShortcutSearchSchedule::Job;
+    using Checkpoint = RAPTOR::ULTRA::ShortcutSearchSchedule::Checkpoint<Shortcut>;
+
 public:
     ULTRABuilder(const Data& data) :
-        data(data) {
-        stopEventGraph.addVertices(data.numberOfStopEvents());
+        data(data),
+        numberOfShortcuts(0),
+        checkpointInterval(0) {
+    }
+
+    // While computing shortcuts, the shortcuts found so far and the completed jobs are periodically saved to the file.
+    inline void enableCheckpoints(const std::string& fileName, const double intervalInSeconds) noexcept {
+        checkpointFile = fileName;
+        checkpointInterval = intervalInSeconds * 1000;
+    }
+
+    // Continues a previous run of computeShortcuts() with the same parameters, skipping the jobs completed before the checkpoint.
+    inline void resumeFromCheckpoint(const std::string& fileName) noexcept {
+        size_t numberOfStopEvents = 0;
+        std::vector<Shortcut> checkpointShortcuts;
+        std::vector<Job> checkpointJobs;
+        IO::deserialize(fileName, numberOfStopEvents, checkpointJobs, checkpointShortcuts);
+        Ensure(numberOfStopEvents == data.numberOfStopEvents(), "Checkpoint " << fileName << " was written for " << numberOfStopEvents << " stop events, but the network has " << data.numberOfStopEvents() << "!");
+        completedJobs.insert(completedJobs.end(), checkpointJobs.begin(), checkpointJobs.end());
+        shortcuts.insert(shortcuts.end(), checkpointShortcuts.begin(), checkpointShortcuts.end());
+        std::cout << "Resuming from checkpoint with " << String::prettyInt(checkpointJobs.size()) << " completed jobs and " << String::prettyInt(checkpointShortcuts.size()) << " shortcuts." << std::endl;
+    }
+
+    void computeShortcuts(const ThreadPinning& threadPinning, const int witnessTransferLimit = 15 * 60, const int minDepartureTime = -never, const int maxDepartureTime = never, const bool verbose = true, const size_t maxDeparturesPerJob = 0, const size_t shard = 0, const size_t numberOfShards = 1) noexcept {
+        collectShortcuts(threadPinning, witnessTransferLimit, {std::make_pair(minDepartureTime, maxDepartureTime)}, verbose, maxDeparturesPerJob, shard, numberOfShards);
+        buildStopEventGraph(threadPinning, verbose);
     }
 
-    void computeShortcuts(const ThreadPinning& threadPinning, const int witnessTransferLimit = 15 * 60, const int minDepartureTime = -never, const int maxDepartureTime = never, const bool verbose = true) noexcept {
+    // Runs the shortcut searches for all departure times in the given disjoint ranges and adds the resulting shortcuts,
+    // without building the stop event graph. Thus, several calls can be followed by a single buildStopEventGraph().
+    void collectShortcuts(const ThreadPinning& threadPinning, const int witnessTransferLimit, const std::vector<std::pair<int, int>>& departureTimeRanges, const bool verbose = true, const size_t maxDeparturesPerJob = 0, const size_t shard = 0, const size_t numberOfShards = 1) noexcept {
         if (verbose) std::cout << "Computing shortcuts with " << threadPinning.numberOfThreads << " threads." << std::endl;
+        AssertMsg(shard < numberOfShards, "Shard " << shard << " is out of range (number of shards: " << numberOfShards << ")!");
+        for (size_t i = 1; i < departureTimeRanges.size(); i++) {
+            AssertMsg(departureTimeRanges[i - 1].second < departureTimeRanges[i].first, "The departure time ranges are not sorted and disjoint!");
+        }
 
-        std::vector<Shortcut> shortcuts;
+        const std::vector<typename ShortcutSearch<Debug>::Station> stationOfStop = ShortcutSearch<Debug>::ComputeStationOfStop(data.raptorData);
 
+        RAPTOR::ULTRA::ShortcutSearchSchedule schedule(threadPinning.numberOfThreads, maxDeparturesPerJob, checkpointFile.empty() ? 0 : checkpointInterval);
         Progress progress(data.numberOfStops(), verbose);
         omp_set_num_threads(threadPinning.numberOfThreads);
         #pragma omp parallel
         {
             threadPinning.pinThread();
 
-            ShortcutSearch<Debug> shortcutSearch(data, witnessTransferLimit);
+            ShortcutSearch<Debug> shortcutSearch(data, stationOfStop, witnessTransferLimit);
 
             #pragma omp for schedule(dynamic)
             for (size_t i = 0; i < data.numberOfStops(); i++) {
-                shortcutSearch.run(StopId(i), minDepartureTime, maxDepartureTime);
-                progress++;
+                if (i % numberOfShards != shard) continue;
+                for (const std::pair<int, int>& range : departureTimeRanges) {
+                    schedule.addSource(StopId(i), shortcutSearch.getDepartureTimes(StopId(i), range.first, range.second), range.first, range.second);
+                }
             }
 
-            #pragma omp critical
+            #pragma omp single
             {
-                const std::vector<Shortcut>& localShortcuts = shortcutSearch.getShortcuts();
-                for (const Shortcut& shortcut : localShortcuts) {
-                    shortcuts.emplace_back(shortcut);
+                schedule.sortJobs();
+                schedule.removeJobs(completedJobs);
+                progress.init(schedule.numberOfJobs());
+            }
+
+            Timer jobTimer;
+            size_t numberOfFlushedShortcuts = 0;
+            #pragma omp for schedule(dynamic,1) nowait
+            for (size_t i = 0; i < schedule.numberOfJobs(); i++) {
+                jobTimer.restart();
+                shortcutSearch.run(schedule[i].source, schedule[i].minDepartureTime, schedule[i].maxDepartureTime);
+                schedule.addBusyTime(jobTimer.elapsedMilliseconds());
+                schedule.completeJob(i);
+                progress++;
+                if (schedule.isCheckpointDue()) {
+                    Checkpoint checkpoint;
+                    #pragma omp critical
+                    {
+                        numberOfFlushedShortcuts = flushShortcuts(shortcutSearch.getShortcuts(), numberOfFlushedShortcuts);
+                        if (schedule.flushCompletedJobs(completedJobs)) checkpoint = schedule.takeCheckpoint(completedJobs, shortcuts);
+                    }
+                    if (checkpoint.id > 0) schedule.writeCheckpoint(checkpointFile, data.numberOfStopEvents(), checkpoint);
                 }
             }
-        }
+            schedule.finishThread();
+
+            #pragma omp barrier
+            #pragma omp single
+            numberOfShortcuts = shortcuts.size();
 
-        std::sort(shortcuts.begin(), shortcuts.end(), [](const Shortcut& a, const Shortcut& b){
-            return (a.origin < b.origin) || ((a.origin == b.origin) && (a.destination < b.destination));
-        });
-        stopEventGraph.addEdge(Vertex(shortcuts[0].origin), Vertex(shortcuts[0].destination)).set(TravelTime, shortcuts[0].walkingDistance);
-        for (size_t i = 1; i < shortcuts.size(); i++) {
-            if ((shortcuts[i].origin == shortcuts[i - 1].origin) && (shortcuts[i].destination == shortcuts[i - 1].destination)) continue;
-            stopEventGraph.addEdge(Vertex(shortcuts[i].origin), Vertex(shortcuts[i].destination)).set(TravelTime, shortcuts[i].walkingDistance);
+            const std::vector<Shortcut>& localShortcuts = shortcutSearch.getShortcuts();
+            size_t offset;
+            #pragma omp atomic capture
+            {
+                offset = numberOfShortcuts;
+                numberOfShortcuts += localShortcuts.size() - numberOfFlushedShortcuts;
+            }
+
+            #pragma omp barrier
+            #pragma omp single
+            shortcuts.resize(numberOfShortcuts);
+
+            std::copy(localShortcuts.begin() + numberOfFlushedShortcuts, localShortcuts.end(), shortcuts.begin() + offset);
         }
-        stopEventGraph.sortEdges(ToVertex);
 
         progress.finished();
+        if (verbose) schedule.printStatistics();
     }
 
-    inline const DynamicTransferGraph& getStopEventGraph() const noexcept {
+    // Partial results of computeShortcuts() for a shard or a departure time range, which can be merged with
+    // readShortcuts() and buildStopEventGraph().
+    inline void writeShortcuts(const std::string& fileName) const noexcept {
+        IO::serialize(fileName, data.numberOfStopEvents(), shortcuts);
+    }
+
+    inline void readShortcuts(const std::string& fileName) noexcept {
+        size_t numberOfStopEvents = 0;
+        std::vector<Shortcut> newShortcuts;
+        IO::deserialize(fileName, numberOfStopEvents, newShortcuts);
+        Ensure(numberOfStopEvents == data.numberOfStopEvents(), "Shortcuts in " << fileName << " were computed for " << numberOfStopEvents << " stop events, but the network has " << data.numberOfStopEvents() << "!");
+        shortcuts.insert(shortcuts.end(), newShortcuts.begin(), newShortcuts.end());
+    }
+
+    // Adds shortcuts that are known to be valid without a search, e.g. the unchanged part of a previous stop event graph.
+    inline void addShortcuts(const std::vector<Shortcut>& newShortcuts) noexcept {
+        shortcuts.insert(shortcuts.end(), newShortcuts.begin(), newShortcuts.end());
+    }
+
+    // Builds the stop event graph directly in CSR format: The shortcuts are distributed to their origins with a parallel
+    // counting sort, afterwards the destinations of each origin are sorted and deduplicated independently.
+    inline void buildStopEventGraph(const ThreadPinning& threadPinning = ThreadPinning(numberOfCores(), 1), const bool verbose = false) noexcept {
+        Timer timer;
+        const size_t numberOfStopEvents = data.numberOfStopEvents();
+        std::vector<std::vector<std::vector<size_t>>> shortcutsOfBlock;
+        std::vector<size_t> firstShortcutOfOrigin(numberOfStopEvents + 1, 0);
+        std::vector<size_t> shortcutBlockSum;
+        std::vector<Vertex> destinations(shortcuts.size());
+        std::vector<Edge> beginOut(numberOfStopEvents + 1, Edge(0));
+        std::vector<Edge> edgeBlockSum;
+        omp_set_num_threads(threadPinning.numberOfThreads);
+        #pragma omp parallel
+        {
+            threadPinning.pinThread();
+            const size_t threadId = omp_get_thread_num();
+            const size_t numberOfThreads = omp_get_num_threads();
+            const auto [firstOrigin, endOrigin] = getThreadBlock(numberOfStopEvents);
+            const size_t blockSize = (numberOfStopEvents + numberOfThreads - 1) / numberOfThreads;
+
+            #pragma omp single
+            shortcutsOfBlock.assign(numberOfThreads, std::vector<std::vector<size_t>>(numberOfThreads));
+
+            // Every thread owns a block of origins, so the shortcuts are handed to the owner of their origin.
+            #pragma omp for schedule(static)
+            for (size_t i = 0; i < shortcuts.size(); i++) {
+                shortcutsOfBlock[threadId][shortcuts[i].origin / blockSize].emplace_back(i);
+            }
+
+            for (const std::vector<std::vector<size_t>>& localShortcutsOfBlock : shortcutsOfBlock) {
+                for (const size_t i : localShortcutsOfBlock[threadId]) {
+                    firstShortcutOfOrigin[shortcuts[i].origin + 1]++;
+                }
+            }
+            #pragma omp barrier
+            parallelPrefixSum(firstShortcutOfOrigin, shortcutBlockSum);
+
+            std::vector<size_t> nextShortcutOfOrigin(firstShortcutOfOrigin.begin() + firstOrigin, firstShortcutOfOrigin.begin() + endOrigin);
+            for (const std::vector<std::vector<size_t>>& localShortcutsOfBlock : shortcutsOfBlock) {
+                for (const size_t i : localShortcutsOfBlock[threadId]) {
+                    destinations[nextShortcutOfOrigin[shortcuts[i].origin - firstOrigin]++] = Vertex(shortcuts[i].destination);
+                }
+            }
+            #pragma omp barrier
+
+            #pragma omp for schedule(dynamic,1024)
+            for (size_t origin = 0; origin < numberOfStopEvents; origin++) {
+                const auto begin = destinations.begin() + firstShortcutOfOrigin[origin];
+                const auto end = destinations.begin() + firstShortcutOfOrigin[origin + 1];
+                std::sort(begin, end);
+                beginOut[origin + 1] = Edge(std::unique(begin, end) - begin);
+            }
+
+            parallelPrefixSum(beginOut, edgeBlockSum);
+            #pragma omp single
+            stopEventGraph.setAdjacencyStructure(std::move(beginOut));
+
+            #pragma omp for schedule(dynamic,1024)
+            for (size_t origin = 0; origin < numberOfStopEvents; origin++) {
+                const Edge firstEdge = stopEventGraph.beginEdgeFrom(Vertex(origin));
+                const size_t degree = stopEventGraph.outDegree(Vertex(origin));
+                std::copy(destinations.begin() + firstShortcutOfOrigin[origin], destinations.begin() + firstShortcutOfOrigin[origin] + degree, stopEventGraph.get(ToVertex).begin() + firstEdge);
+            }
+        }
+        if (verbose) std::cout << "Built stop event graph with " << String::prettyInt(stopEventGraph.numEdges()) << " edges from " << String::prettyInt(shortcuts.size()) << " shortcuts in " << String::msToString(timer.elapsedMilliseconds()) << std::endl;
+    }
+
+    inline const std::vector<Shortcut>& getShortcuts() const noexcept {
+        return shortcuts;
+    }
+
+    inline const SimpleStaticGraph& getStopEventGraph() const noexcept {
         return stopEventGraph;
     }
 
-    inline DynamicTransferGraph& getStopEventGraph() noexcept {
+    inline SimpleStaticGraph& getStopEventGraph() noexcept {
         return stopEventGraph;
     }
 
+private:
+    inline size_t flushShortcuts(const std::vector<Shortcut>& localShortcuts, const size_t numberOfFlushedShortcuts) noexcept {
+        shortcuts.insert(shortcuts.end(), localShortcuts.begin() + numberOfFlushedShortcuts, localShortcuts.end());
+        return localShortcuts.size();
+    }
+
 private:
     const Data& data;
-    DynamicTransferGraph stopEventGraph;
+    std::vector<Shortcut> shortcuts;
+    size_t numberOfShortcuts;
+    SimpleStaticGraph stopEventGraph;
+
+    std::string checkpointFile;
+    double checkpointInterval;
+    std::vector<Job> completedJobs;
 
 };
 
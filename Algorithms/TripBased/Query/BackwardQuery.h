@@ -0,0 +1,306 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "ReachedIndex.h"
+
+#include "../../CH/Query/BucketQuery.h"
+
+#include "../../../DataStructures/TripBased/Data.h"
+
+namespace TripBased {
+
+struct ArriveByJourney {
+    ArriveByJourney(const int departureTime = never, const u_int32_t numberOfUsedVehicles = 0) :
+        departureTime(departureTime),
+        numberOfUsedVehicles(numberOfUsedVehicles) {
+    }
+    inline bool operator==(const ArriveByJourney& other) const noexcept {
+        return (departureTime == other.departureTime) && (numberOfUsedVehicles == other.numberOfUsedVehicles);
+    }
+    inline bool operator!=(const ArriveByJourney& other) const noexcept {
+        return !(*this == other);
+    }
+    inline friend std::ostream& operator<<(std::ostream& out, const ArriveByJourney& j) noexcept {
+        return out << "departureTime: " << j.departureTime << ", numberOfUsedVehicles: " << j.numberOfUsedVehicles;
+    }
+    int departureTime;
+    u_int32_t numberOfUsedVehicles;
+};
+
+// Latest departure ("arrive by") query: Computes the Pareto set of journeys w.r.t. departure time and number of trips
+// that arrive at the target no later than the given arrival time. This is a Trip-Based query on the reversed network
+// (see Data::reverseNetwork()), which scans the trips backwards in time. The walking distances to the target are taken
+// from the backward Bucket-CH search and used for the initial transfers, the distances from the source for the final ones.
+template<typename REACHED_INDEX, bool DEBUG = false>
+class BackwardQuery {
+
+public:
+    using ReachedIndex = REACHED_INDEX;
+    static constexpr bool Debug = DEBUG;
+    using Type = BackwardQuery<ReachedIndex, Debug>;
+
+private:
+    struct TripLabel {
+        TripLabel(const u_int32_t begin, const u_int32_t end) :
+            begin(begin),
+            end(end) {
+        }
+        u_int32_t begin;
+        u_int32_t end;
+    };
+
+public:
+    // The reverseData has to be the result of Data::reverseNetwork(), while chData is the CH of the original network.
+    BackwardQuery(const Data& reverseData, const CH::CH& chData) :
+        BackwardQuery(reverseData, chData, CH::BucketQuery<CHGraph, true, false>::buildBucketGraph(chData.forward, chData.backward, chData.forward[Weight], chData.backward[Weight], reverseData.numberOfStops())) {
+    }
+
+    BackwardQuery(const Data& reverseData, const CH::CH& chData, const std::shared_ptr<const CH::BucketGraph>& bucketGraph) :
+        data(reverseData),
+        bucketQuery(chData.forward, chData.backward, bucketGraph, Weight),
+        reachedIndex(reverseData),
+        reachedRoutes(reverseData.numberOfRoutes(), false),
+        edgeLabels(reverseData.edgeLabels),
+        routeLabels(reverseData.routeLabels) {
+        AssertMsg(data.hasQueryLabels(), "The query labels of the Trip-Based data are missing!");
+    }
+
+    inline void run(const Vertex source, const int arrivalTime, const Vertex target) noexcept {
+        if (Debug) totalTimer.restart();
+        clear();
+        computeInitialAndFinalTransfers(source, arrivalTime, target);
+        evaluateInitialTransfers(arrivalTime);
+        scanTrips();
+        if (Debug) totalTime += totalTimer.elapsedMicroseconds();
+    }
+
+    inline int getLatestDepartureTime() const noexcept {
+        return toDepartureTime(minArrivalTimeByMaxNumberOfUsedVehicles.back());
+    }
+
+    inline int getLatestDepartureNumberOfTrips() const noexcept {
+        const int rat = minArrivalTimeByMaxNumberOfUsedVehicles.back();
+        for (size_t i = 0; i < minArrivalTimeByMaxNumberOfUsedVehicles.size(); i++) {
+            if (minArrivalTimeByMaxNumberOfUsedVehicles[i] == rat) return i;
+        }
+        return -1;
+    }
+
+    inline std::vector<ArriveByJourney> getJourneys() const noexcept {
+        std::vector<ArriveByJourney> result;
+        for (size_t i = 0; i < minArrivalTimeByMaxNumberOfUsedVehicles.size(); i++) {
+            if (minArrivalTimeByMaxNumberOfUsedVehicles[i] >= INFTY) continue;
+            const int departureTime = toDepartureTime(minArrivalTimeByMaxNumberOfUsedVehicles[i]);
+            if ((result.size() >= 1) && (result.back().departureTime == departureTime)) continue;
+            result.emplace_back(departureTime, i);
+        }
+        return result;
+    }
+
+    inline void debug(const double f = 1.0) noexcept {
+        std::cout << "Number of enqueued trips: " << String::prettyDouble(enqueueCount / f, 0) << std::endl;
+        std::cout << "Number of scanned trips: " << String::prettyDouble(scannedTripsCount / f, 0) << std::endl;
+        std::cout << "Number of scanned stops: " << String::prettyDouble(scannedStopsCount / f, 0) << std::endl;
+        std::cout << "Number of scanned shortcuts: " << String::prettyDouble(scannedShortcutCount / f, 0) << std::endl;
+        std::cout << "Number of rounds: " << String::prettyDouble(roundCount / f, 2) << std::endl;
+        std::cout << "Number of found journeys: " << String::prettyDouble(addJourneyCount / f, 0) << std::endl;
+        std::cout << "Bucket-CH query time: " << String::musToString(chTime / f) << std::endl;
+        std::cout << "Initial transfer evaluation time: " << String::musToString(initialTime / f) << std::endl;
+        std::cout << "Trip scanning time: " << String::musToString(scanTime / f) << std::endl;
+        std::cout << "total time: " << String::musToString(totalTime / f) << std::endl;
+        addJourneyCount = 0;
+        enqueueCount = 0;
+        scannedTripsCount = 0;
+        scannedStopsCount = 0;
+        scannedShortcutCount = 0;
+        roundCount = 0;
+        chTime = 0.0;
+        initialTime = 0.0;
+        scanTime = 0.0;
+        totalTime = 0.0;
+    }
+
+private:
+    // Times in the reversed network are negated, therefore the arrival time in the reversed network is the negated
+    // departure time in the original network.
+    inline static int toDepartureTime(const int reverseArrivalTime) noexcept {
+        return (reverseArrivalTime >= INFTY) ? never : -reverseArrivalTime;
+    }
+
+    inline void clear() noexcept {
+        currentQueue.clear();
+        nextQueue.clear();
+        reachedIndex.clear();
+        numberOfUsedVehicles = 0;
+        minArrivalTime = INFTY;
+        minArrivalTimeByMaxNumberOfUsedVehicles.assign(1, INFTY);
+    }
+
+    inline void computeInitialAndFinalTransfers(const Vertex source, const int arrivalTime, const Vertex target) noexcept {
+        if (Debug) chTimer.restart();
+        bucketQuery.run(source, target);
+        if (bucketQuery.getDistance() != INFTY) {
+            addJourney(bucketQuery.getDistance() - arrivalTime);
+        }
+        if (Debug) chTime += chTimer.elapsedMicroseconds();
+    }
+
+    inline void evaluateInitialTransfers(const int arrivalTime) noexcept {
+        if (Debug) initialTimer.restart();
+        const int departureTime = -arrivalTime;
+        for (const Vertex stop : bucketQuery.getBackwardPOIs()) {
+            for (const RAPTOR::RouteSegment& route : data.raptorData.routesContainingStop(StopId(stop))) {
+                reachedRoutes[route.routeId] = true;
+            }
+        }
+        for (const RouteId route : data.raptorData.routes()) {
+            if (!reachedRoutes[route]) continue;
+            reachedRoutes[route] = false;
+            const RouteLabel& label = routeLabels[route];
+            const int* departureTimes = data.departureTimesOfRoute(route);
+            const StopIndex endIndex = label.end();
+            const TripId firstTrip = data.firstTripOfRoute[route];
+            const StopId* stops = data.raptorData.stopArrayOfRoute(route);
+            TripId tripIndex = noTripId;
+            for (StopIndex stopIndex(0); stopIndex < endIndex; stopIndex++) {
+                const int timeToTarget = bucketQuery.getBackwardDistance(stops[stopIndex]);
+                if (timeToTarget == INFTY) continue;
+                const u_int32_t labelIndex = stopIndex * label.numberOfTrips;
+                if (tripIndex >= label.numberOfTrips) {
+                    tripIndex = std::lower_bound(TripId(0), TripId(label.numberOfTrips), departureTime + timeToTarget, [&](const TripId trip, const int time) {
+                        return departureTimes[labelIndex + trip] < time;
+                    });
+                    if (tripIndex >= label.numberOfTrips) continue;
+                } else {
+                    const int stopDepartureTime = departureTime + timeToTarget;
+                    if (departureTimes[labelIndex + tripIndex - 1] < stopDepartureTime) continue;
+                    tripIndex--;
+                    while ((tripIndex > 0) && (departureTimes[labelIndex + tripIndex - 1] >= stopDepartureTime)) {
+                        tripIndex--;
+                    }
+                }
+                enqueue(firstTrip + tripIndex, stopIndex);
+                if (tripIndex == 0) break;
+            }
+        }
+        if (Debug) initialTime += initialTimer.elapsedMicroseconds();
+    }
+
+    inline void scanTrips() noexcept {
+        if (Debug) scanTimer.restart();
+        while (!nextQueue.empty()) {
+            if constexpr (Debug) roundCount++;
+            currentQueue.swap(nextQueue);
+            numberOfUsedVehicles++;
+            for (const TripLabel& label : currentQueue) { // Evaluate final transfers in order to check if the source is reachable
+                if constexpr (Debug) scannedTripsCount++;
+                for (StopEventId i(label.begin); i < label.end; i++) {
+                    if constexpr (Debug) scannedStopsCount++;
+                    if (data.arrivalEvents[i].arrivalTime >= minArrivalTime) break;
+                    const int timeFromSource = bucketQuery.getForwardDistance(data.arrivalEvents[i].stop);
+                    if (timeFromSource != INFTY) addJourney(data.arrivalEvents[i].arrivalTime + timeFromSource);
+                }
+            }
+            for (TripLabel& label : currentQueue) { // Find the range of transfers for each trip
+                for (StopEventId i(label.begin); i < label.end; i++) {
+                    if (data.arrivalEvents[i].arrivalTime >= minArrivalTime) label.end = i;
+                }
+                label.begin = data.stopEventGraph.beginEdgeFrom(Vertex(label.begin));
+                label.end = data.stopEventGraph.beginEdgeFrom(Vertex(label.end));
+            }
+            for (const TripLabel& label : currentQueue) { // Relax the transfers for each trip
+                for (Edge edge(label.begin); edge < label.end; edge++) {
+                    if constexpr (Debug) scannedShortcutCount++;
+                    enqueue(edge);
+                }
+            }
+            currentQueue.clear();
+        }
+        if (Debug) scanTime += scanTimer.elapsedMicroseconds();
+    }
+
+    inline void enqueue(const TripId trip, const StopIndex index) noexcept {
+        if constexpr (Debug) enqueueCount++;
+        if (reachedIndex.alreadyReached(trip, index + 1)) return;
+        const StopEventId firstEvent = data.firstStopEventOfTrip[trip];
+        nextQueue.emplace_back(firstEvent + index + 1, firstEvent + reachedIndex(trip));
+        reachedIndex.update(trip, index);
+    }
+
+    inline void enqueue(const Edge edge) noexcept {
+        if constexpr (Debug) enqueueCount++;
+        const EdgeLabel& label = edgeLabels[edge];
+        if (reachedIndex.alreadyReached(label.trip, label.stopEvent - label.firstEvent)) return;
+        nextQueue.emplace_back(label.stopEvent, StopEventId(label.firstEvent + reachedIndex(label.trip)));
+        reachedIndex.update(label.trip, StopIndex(label.stopEvent - label.firstEvent));
+    }
+
+    inline void addJourney(const int newArrivalTime) noexcept {
+        if constexpr (Debug) addJourneyCount++;
+        if (numberOfUsedVehicles >= minArrivalTimeByMaxNumberOfUsedVehicles.size()) {
+            minArrivalTimeByMaxNumberOfUsedVehicles.resize(numberOfUsedVehicles + 1, minArrivalTimeByMaxNumberOfUsedVehicles.back());
+        }
+        AssertMsg(numberOfUsedVehicles + 1 == minArrivalTimeByMaxNumberOfUsedVehicles.size(), "Wrong number of used vehicles!");
+        minArrivalTimeByMaxNumberOfUsedVehicles[numberOfUsedVehicles] = std::min(minArrivalTimeByMaxNumberOfUsedVehicles[numberOfUsedVehicles], newArrivalTime);
+        minArrivalTime = minArrivalTimeByMaxNumberOfUsedVehicles[numberOfUsedVehicles];
+    }
+
+private:
+    const Data& data;
+
+    CH::BucketQuery<CHGraph, true, false> bucketQuery;
+    std::vector<TripLabel> currentQueue;
+    std::vector<TripLabel> nextQueue;
+    ReachedIndex reachedIndex;
+    std::vector<bool> reachedRoutes;
+
+    // Arrival times in the reversed network, i.e., negated departure times
+    int minArrivalTime;
+    u_int32_t numberOfUsedVehicles;
+    std::vector<int> minArrivalTimeByMaxNumberOfUsedVehicles;
+
+    const MappedVector<EdgeLabel>& edgeLabels;
+    const std::vector<RouteLabel>& routeLabels;
+
+    size_t addJourneyCount{0};
+    size_t enqueueCount{0};
+    size_t scannedTripsCount{0};
+    size_t scannedStopsCount{0};
+    size_t scannedShortcutCount{0};
+    size_t roundCount{0};
+    Timer chTimer;
+    Timer initialTimer;
+    Timer scanTimer;
+    Timer totalTimer;
+    double chTime{0.0};
+    double initialTime{0.0};
+    double scanTime{0.0};
+    double totalTime{0.0};
+
+};
+
+}
@@ -0,0 +1,83 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "../../CH/CH.h"
+#include "../../CH/Query/BucketQuery.h"
+#include "../../Dijkstra/Dijkstra.h"
+
+#include "../../../DataStructures/TripBased/Data.h"
+
+namespace TripBased {
+
+// Lower bounds for the remaining travel time from every stop to a target, which are used by the query for target
+// pruning. The final transfers to the target are taken from a backward Bucket-CH search without target pruning,
+// the remaining journey is bounded by a multi-source backward Dijkstra search on the reversed min travel time graph
+// of the network (see RAPTOR::Data::minTravelTimeGraph()). The table is only recomputed if the target changes.
+class LowerBoundTable {
+
+public:
+    LowerBoundTable(const Data& data, const CH::CH& chData, const std::shared_ptr<const CH::BucketGraph>& bucketGraph) :
+        reverseGraph(buildReverseGraph(data)),
+        bucketQuery(chData.forward, chData.backward, bucketGraph, Weight),
+        dijkstra(reverseGraph),
+        bound(data.numberOfStops(), 0),
+        target(noVertex) {
+    }
+
+    inline void run(const Vertex newTarget) noexcept {
+        if (target == newTarget) return;
+        target = newTarget;
+        bucketQuery.template run<BACKWARD, FORWARD, false>(target);
+        dijkstra.clear();
+        for (const Vertex stop : bucketQuery.getBackwardPOIs()) {
+            dijkstra.addSource(stop, bucketQuery.getBackwardDistance(stop));
+        }
+        dijkstra.run();
+        for (size_t stop = 0; stop < bound.size(); stop++) {
+            bound[stop] = dijkstra.reachable(Vertex(stop)) ? dijkstra.getDistance(Vertex(stop)) : INFTY;
+        }
+    }
+
+    inline int operator[](const StopId stop) const noexcept {
+        return bound[stop];
+    }
+
+private:
+    inline static TransferGraph buildReverseGraph(const Data& data) noexcept {
+        TransferGraph result = data.raptorData.minTravelTimeGraph();
+        result.revert();
+        return result;
+    }
+
+private:
+    TransferGraph reverseGraph;
+    CH::BucketQuery<CHGraph, true, false> bucketQuery;
+    Dijkstra<TransferGraph, false> dijkstra;
+    std::vector<int> bound;
+    Vertex target;
+
+};
+
+}
@@ -0,0 +1,322 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "ReachedIndex.h"
+
+#include "../../CH/CH.h"
+#include "../../CH/Query/BucketQuery.h"
+
+#include "../../../DataStructures/TripBased/Data.h"
+
+namespace TripBased {
+
+// One-to-all variant of the Trip-Based query: Computes the earliest arrival time at every stop for every maximum number
+// of trips, as well as the earliest arrival time at every vertex of the CH, optionally restricted to a time budget.
+// Since there is no target, the trips are pruned with the time budget only. The arrival times at the stops are recorded
+// while scanning the arrival events. Afterwards, the final transfers to all vertices are computed by a PHAST-style sweep
+// over the CH: an upward sweep in topological order followed by a downward sweep in reverse order.
+template<typename REACHED_INDEX, bool DEBUG = false>
+class OneToAllQuery {
+
+public:
+    using ReachedIndex = REACHED_INDEX;
+    static constexpr bool Debug = DEBUG;
+    using Type = OneToAllQuery<ReachedIndex, Debug>;
+
+private:
+    struct TripLabel {
+        TripLabel(const u_int32_t begin, const u_int32_t end) :
+            begin(begin),
+            end(end) {
+        }
+        u_int32_t begin;
+        u_int32_t end;
+    };
+
+public:
+    OneToAllQuery(const Data& data, const CH::CH& chData) :
+        OneToAllQuery(data, chData, CH::BucketQuery<CHGraph, true, false>::buildBucketGraph(chData.forward, chData.backward, chData.forward[Weight], chData.backward[Weight], data.numberOfStops())) {
+    }
+
+    OneToAllQuery(const Data& data, const CH::CH& chData, const std::shared_ptr<const CH::BucketGraph>& bucketGraph) :
+        data(data),
+        chData(chData),
+        bucketQuery(chData.forward, chData.backward, bucketGraph, Weight),
+        reachedIndex(data),
+        reachedRoutes(data.numberOfRoutes(), false),
+        edgeLabels(data.edgeLabels),
+        routeLabels(data.routeLabels),
+        arrivalTime(chData.numVertices(), INFTY) {
+        AssertMsg(data.hasQueryLabels(), "The query labels of the Trip-Based data are missing!");
+        AssertMsg(chData.numVertices() >= data.numberOfStops(), "The CH has only " << chData.numVertices() << " vertices, but there are " << data.numberOfStops() << " stops!");
+        computeSweepOrder();
+    }
+
+    // Computes the earliest arrival times for all journeys arriving no later than departureTime + timeBudget.
+    inline void run(const Vertex source, const int departureTime, const int timeBudget = INFTY) noexcept {
+        if (Debug) totalTimer.restart();
+        clear();
+        maxArrivalTime = (timeBudget >= INFTY) ? INFTY : departureTime + timeBudget;
+        evaluateInitialTransfers(source, departureTime);
+        scanTrips();
+        computeFinalTransfers(source, departureTime);
+        if (Debug) totalTime += totalTimer.elapsedMicroseconds();
+    }
+
+    // Number of rounds, i.e., the maximum number of trips of an optimal journey plus one.
+    inline size_t numberOfRounds() const noexcept {
+        return stopArrivalTimeByMaxNumberOfUsedVehicles.size();
+    }
+
+    // Earliest arrival time at every stop using at most the given number of trips, excluding the final transfer.
+    inline const std::vector<int>& getStopArrivalTimes(const size_t maxNumberOfUsedVehicles) const noexcept {
+        return stopArrivalTimeByMaxNumberOfUsedVehicles[std::min(maxNumberOfUsedVehicles, numberOfRounds() - 1)];
+    }
+
+    // Earliest arrival time at every vertex of the CH, including the final transfer. Vertices that cannot be reached
+    // within the time budget have arrival time INFTY.
+    inline const std::vector<int>& getArrivalTimes() const noexcept {
+        return arrivalTime;
+    }
+
+    inline int getArrivalTime(const Vertex vertex) const noexcept {
+        return arrivalTime[vertex];
+    }
+
+    inline void debug(const double f = 1.0) noexcept {
+        std::cout << "Number of enqueued trips: " << String::prettyDouble(enqueueCount / f, 0) << std::endl;
+        std::cout << "Number of scanned trips: " << String::prettyDouble(scannedTripsCount / f, 0) << std::endl;
+        std::cout << "Number of scanned stops: " << String::prettyDouble(scannedStopsCount / f, 0) << std::endl;
+        std::cout << "Number of scanned shortcuts: " << String::prettyDouble(scannedShortcutCount / f, 0) << std::endl;
+        std::cout << "Number of rounds: " << String::prettyDouble(roundCount / f, 2) << std::endl;
+        std::cout << "Bucket-CH query time: " << String::musToString(chTime / f) << std::endl;
+        std::cout << "Initial transfer evaluation time: " << String::musToString(initialTime / f) << std::endl;
+        std::cout << "Trip scanning time: " << String::musToString(scanTime / f) << std::endl;
+        std::cout << "Final transfer sweep time: " << String::musToString(sweepTime / f) << std::endl;
+        std::cout << "total time: " << String::musToString(totalTime / f) << std::endl;
+        enqueueCount = 0;
+        scannedTripsCount = 0;
+        scannedStopsCount = 0;
+        scannedShortcutCount = 0;
+        roundCount = 0;
+        chTime = 0.0;
+        initialTime = 0.0;
+        scanTime = 0.0;
+        sweepTime = 0.0;
+        totalTime = 0.0;
+    }
+
+private:
+    // All CH edges point from lower to higher ranked vertices, so a topological order of the union of the forward and
+    // backward graphs is a valid order for the upward sweep.
+    inline void computeSweepOrder() noexcept {
+        std::vector<u_int32_t> inDegree(chData.numVertices(), 0);
+        for (const Vertex vertex : chData.forward.vertices()) {
+            for (const Edge edge : chData.forward.edgesFrom(vertex)) {
+                inDegree[chData.forward.get(ToVertex, edge)]++;
+            }
+            for (const Edge edge : chData.backward.edgesFrom(vertex)) {
+                inDegree[chData.backward.get(ToVertex, edge)]++;
+            }
+        }
+        for (const Vertex vertex : chData.forward.vertices()) {
+            if (inDegree[vertex] == 0) sweepOrder.emplace_back(vertex);
+        }
+        for (size_t i = 0; i < sweepOrder.size(); i++) {
+            const Vertex vertex = sweepOrder[i];
+            for (const Edge edge : chData.forward.edgesFrom(vertex)) {
+                if (--inDegree[chData.forward.get(ToVertex, edge)] == 0) sweepOrder.emplace_back(chData.forward.get(ToVertex, edge));
+            }
+            for (const Edge edge : chData.backward.edgesFrom(vertex)) {
+                if (--inDegree[chData.backward.get(ToVertex, edge)] == 0) sweepOrder.emplace_back(chData.backward.get(ToVertex, edge));
+            }
+        }
+        AssertMsg(sweepOrder.size() == chData.numVertices(), "The CH contains a cycle!");
+    }
+
+    inline void clear() noexcept {
+        currentQueue.clear();
+        nextQueue.clear();
+        reachedIndex.clear();
+        stopArrivalTimeByMaxNumberOfUsedVehicles.assign(1, std::vector<int>(data.numberOfStops(), INFTY));
+    }
+
+    inline void evaluateInitialTransfers(const Vertex source, const int departureTime) noexcept {
+        if (Debug) chTimer.restart();
+        bucketQuery.template run<FORWARD, BACKWARD, false>(source);
+        if (Debug) chTime += chTimer.elapsedMicroseconds();
+        if (Debug) initialTimer.restart();
+        std::vector<int>& stopArrivalTime = stopArrivalTimeByMaxNumberOfUsedVehicles.back();
+        for (const Vertex stop : bucketQuery.getForwardPOIs()) {
+            const int walkingArrivalTime = departureTime + bucketQuery.getForwardDistance(stop);
+            if (walkingArrivalTime > maxArrivalTime) continue;
+            stopArrivalTime[stop] = walkingArrivalTime;
+            for (const RAPTOR::RouteSegment& route : data.raptorData.routesContainingStop(StopId(stop))) {
+                reachedRoutes[route.routeId] = true;
+            }
+        }
+        for (const RouteId route : data.raptorData.routes()) {
+            if (!reachedRoutes[route]) continue;
+            reachedRoutes[route] = false;
+            const RouteLabel& label = routeLabels[route];
+            const int* departureTimes = data.departureTimesOfRoute(route);
+            const StopIndex endIndex = label.end();
+            const TripId firstTrip = data.firstTripOfRoute[route];
+            const StopId* stops = data.raptorData.stopArrayOfRoute(route);
+            TripId tripIndex = noTripId;
+            for (StopIndex stopIndex(0); stopIndex < endIndex; stopIndex++) {
+                const int stopDepartureTime = stopArrivalTime[stops[stopIndex]];
+                if (stopDepartureTime == INFTY) continue;
+                const u_int32_t labelIndex = stopIndex * label.numberOfTrips;
+                if (tripIndex >= label.numberOfTrips) {
+                    tripIndex = std::lower_bound(TripId(0), TripId(label.numberOfTrips), stopDepartureTime, [&](const TripId trip, const int time) {
+                        return departureTimes[labelIndex + trip] < time;
+                    });
+                    if (tripIndex >= label.numberOfTrips) continue;
+                } else {
+                    if (departureTimes[labelIndex + tripIndex - 1] < stopDepartureTime) continue;
+                    tripIndex--;
+                    while ((tripIndex > 0) && (departureTimes[labelIndex + tripIndex - 1] >= stopDepartureTime)) {
+                        tripIndex--;
+                    }
+                }
+                enqueue(firstTrip + tripIndex, stopIndex);
+                if (tripIndex == 0) break;
+            }
+        }
+        if (Debug) initialTime += initialTimer.elapsedMicroseconds();
+    }
+
+    inline void scanTrips() noexcept {
+        if (Debug) scanTimer.restart();
+        while (!nextQueue.empty()) {
+            if constexpr (Debug) roundCount++;
+            currentQueue.swap(nextQueue);
+            stopArrivalTimeByMaxNumberOfUsedVehicles.emplace_back(stopArrivalTimeByMaxNumberOfUsedVehicles.back());
+            std::vector<int>& stopArrivalTime = stopArrivalTimeByMaxNumberOfUsedVehicles.back();
+            for (TripLabel& label : currentQueue) { // Record the arrival times and find the range of transfers for each trip
+                if constexpr (Debug) scannedTripsCount++;
+                for (StopEventId i(label.begin); i < label.end; i++) {
+                    if constexpr (Debug) scannedStopsCount++;
+                    const ArrivalEvent& arrivalEvent = data.arrivalEvents[i];
+                    if (arrivalEvent.arrivalTime > maxArrivalTime) {
+                        label.end = i;
+                        break;
+                    }
+                    stopArrivalTime[arrivalEvent.stop] = std::min(stopArrivalTime[arrivalEvent.stop], arrivalEvent.arrivalTime);
+                }
+                label.begin = data.stopEventGraph.beginEdgeFrom(Vertex(label.begin));
+                label.end = data.stopEventGraph.beginEdgeFrom(Vertex(label.end));
+            }
+            for (const TripLabel& label : currentQueue) { // Relax the transfers for each trip
+                for (Edge edge(label.begin); edge < label.end; edge++) {
+                    if constexpr (Debug) scannedShortcutCount++;
+                    enqueue(edge);
+                }
+            }
+            currentQueue.clear();
+        }
+        if (Debug) scanTime += scanTimer.elapsedMicroseconds();
+    }
+
+    inline void computeFinalTransfers(const Vertex source, const int departureTime) noexcept {
+        if (Debug) sweepTimer.restart();
+        const std::vector<int>& stopArrivalTime = stopArrivalTimeByMaxNumberOfUsedVehicles.back();
+        std::fill(arrivalTime.begin(), arrivalTime.end(), INFTY);
+        std::copy(stopArrivalTime.begin(), stopArrivalTime.end(), arrivalTime.begin());
+        arrivalTime[source] = departureTime;
+        for (const Vertex vertex : sweepOrder) {
+            if ((arrivalTime[vertex] >= INFTY) || (arrivalTime[vertex] > maxArrivalTime)) continue;
+            for (const Edge edge : chData.forward.edgesFrom(vertex)) {
+                const Vertex other = chData.forward.get(ToVertex, edge);
+                arrivalTime[other] = std::min(arrivalTime[other], arrivalTime[vertex] + chData.forward.get(Weight, edge));
+            }
+        }
+        for (size_t i = sweepOrder.size(); i > 0; i--) {
+            const Vertex vertex = sweepOrder[i - 1];
+            for (const Edge edge : chData.backward.edgesFrom(vertex)) {
+                const Vertex other = chData.backward.get(ToVertex, edge);
+                arrivalTime[vertex] = std::min(arrivalTime[vertex], arrivalTime[other] + chData.backward.get(Weight, edge));
+            }
+            if (arrivalTime[vertex] > maxArrivalTime) arrivalTime[vertex] = INFTY;
+        }
+        if (Debug) sweepTime += sweepTimer.elapsedMicroseconds();
+    }
+
+    inline void enqueue(const TripId trip, const StopIndex index) noexcept {
+        if constexpr (Debug) enqueueCount++;
+        if (reachedIndex.alreadyReached(trip, index + 1)) return;
+        const StopEventId firstEvent = data.firstStopEventOfTrip[trip];
+        nextQueue.emplace_back(firstEvent + index + 1, firstEvent + reachedIndex(trip));
+        reachedIndex.update(trip, index);
+    }
+
+    inline void enqueue(const Edge edge) noexcept {
+        if constexpr (Debug) enqueueCount++;
+        const EdgeLabel& label = edgeLabels[edge];
+        if (reachedIndex.alreadyReached(label.trip, label.stopEvent - label.firstEvent)) return;
+        nextQueue.emplace_back(label.stopEvent, StopEventId(label.firstEvent + reachedIndex(label.trip)));
+        reachedIndex.update(label.trip, StopIndex(label.stopEvent - label.firstEvent));
+    }
+
+private:
+    const Data& data;
+    const CH::CH& chData;
+
+    CH::BucketQuery<CHGraph, true, false> bucketQuery;
+    std::vector<TripLabel> currentQueue;
+    std::vector<TripLabel> nextQueue;
+    ReachedIndex reachedIndex;
+    std::vector<bool> reachedRoutes;
+
+    const MappedVector<EdgeLabel>& edgeLabels;
+    const std::vector<RouteLabel>& routeLabels;
+
+    int maxArrivalTime{INFTY};
+    std::vector<std::vector<int>> stopArrivalTimeByMaxNumberOfUsedVehicles;
+    std::vector<int> arrivalTime;
+    std::vector<Vertex> sweepOrder;
+
+    size_t enqueueCount{0};
+    size_t scannedTripsCount{0};
+    size_t scannedStopsCount{0};
+    size_t scannedShortcutCount{0};
+    size_t roundCount{0};
+    Timer chTimer;
+    Timer initialTimer;
+    Timer scanTimer;
+    Timer sweepTimer;
+    Timer totalTimer;
+    double chTime{0.0};
+    double initialTime{0.0};
+    double scanTime{0.0};
+    double sweepTime{0.0};
+    double totalTime{0.0};
+
+};
+
+}
@@ -0,0 +1,419 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "ReachedIndex.h"
+
+#include "../../CH/Query/BucketQuery.h"
+
+#include "../../../DataStructures/TripBased/Data.h"
+
+namespace TripBased {
+
+struct ProfileJourney {
+    ProfileJourney(const int departureTime = never, const int arrivalTime = never, const u_int32_t numberOfUsedVehicles = 0) :
+        departureTime(departureTime),
+        arrivalTime(arrivalTime),
+        numberOfUsedVehicles(numberOfUsedVehicles) {
+    }
+    inline bool operator==(const ProfileJourney& other) const noexcept {
+        return (departureTime == other.departureTime) && (arrivalTime == other.arrivalTime) && (numberOfUsedVehicles == other.numberOfUsedVehicles);
+    }
+    inline bool operator!=(const ProfileJourney& other) const noexcept {
+        return !(*this == other);
+    }
+    inline friend std::ostream& operator<<(std::ostream& out, const ProfileJourney& j) noexcept {
+        return out << "departureTime: " << j.departureTime << ", arrivalTime: " << j.arrivalTime << ", numberOfUsedVehicles: " << j.numberOfUsedVehicles;
+    }
+    int departureTime;
+    int arrivalTime;
+    u_int32_t numberOfUsedVehicles;
+};
+
+// Range query in the style of rTBTR: All departure times within the range are processed in decreasing order.
+// The Bucket-CH search is performed only once, and the reached index as well as the arrival time bounds are kept
+// from one departure time to the next, since every journey found for a later departure time dominates the journeys
+// with the same arrival time and at least as many trips for all earlier departure times. In order to stay correct
+// w.r.t. the number of trips, there is one reached index per round.
+template<typename REACHED_INDEX, bool DEBUG = false>
+class ProfileQuery {
+
+public:
+    using ReachedIndex = REACHED_INDEX;
+    static constexpr bool Debug = DEBUG;
+    using Type = ProfileQuery<ReachedIndex, Debug>;
+
+private:
+    struct TripLabel {
+        TripLabel(const u_int32_t begin, const u_int32_t end) :
+            begin(begin),
+            end(end) {
+        }
+        u_int32_t begin;
+        u_int32_t end;
+    };
+
+    struct DepartureLabel {
+        DepartureLabel(const int departureTime = never, const TripId trip = noTripId, const StopIndex stopIndex = noStopIndex) :
+            departureTime(departureTime),
+            trip(trip),
+            stopIndex(stopIndex) {
+        }
+        inline bool operator<(const DepartureLabel& other) const noexcept {
+            return departureTime > other.departureTime;
+        }
+        int departureTime;
+        TripId trip;
+        StopIndex stopIndex;
+    };
+
+public:
+    ProfileQuery(const Data& data, const CH::CH& chData) :
+        ProfileQuery(data, chData, CH::BucketQuery<CHGraph, true, false>::buildBucketGraph(chData.forward, chData.backward, chData.forward[Weight], chData.backward[Weight], data.numberOfStops())) {
+    }
+
+    ProfileQuery(const Data& data, const CH::CH& chData, const std::shared_ptr<const CH::BucketGraph>& bucketGraph) :
+        data(data),
+        bucketQuery(chData.forward, chData.backward, bucketGraph, Weight),
+        reachedIndices(1, ReachedIndex(data)),
+        reachedRoutes(data.numberOfRoutes(), false),
+        edgeLabels(data.edgeLabels),
+        routeLabels(data.routeLabels) {
+        AssertMsg(data.hasQueryLabels(), "The query labels of the Trip-Based data are missing!");
+    }
+
+    // Computes all Pareto-optimal journeys (w.r.t. departure time, arrival time, and number of trips) departing
+    // from source within [minDepartureTime, maxDepartureTime]. Journeys that only depart after maxDepartureTime
+    // are used for domination, but are not part of the profile. Walking directly to the target is not part of
+    // the profile either (see getDirectTransferTime()), but all journeys dominated by it are omitted.
+    inline void run(const Vertex source, const int minDepartureTime, const int maxDepartureTime, const Vertex target) noexcept {
+        if (Debug) totalTimer.restart();
+        clear();
+        computeInitialAndFinalTransfers(source, target);
+        collectDepartures(minDepartureTime, maxDepartureTime);
+        evaluateInitialTransfers(maxDepartureTime + 1);
+        scanTrips();
+        previousMinArrivalTimes = minArrivalTimeByMaxNumberOfUsedVehicles;
+        for (size_t i = 0; i < departures.size();) {
+            const int departureTime = departures[i].departureTime;
+            if (Debug) initialTimer.restart();
+            startNewDepartureTime(departureTime);
+            for (; (i < departures.size()) && (departures[i].departureTime == departureTime); i++) {
+                enqueue(departures[i].trip, departures[i].stopIndex);
+            }
+            if (Debug) initialTime += initialTimer.elapsedMicroseconds();
+            scanTrips();
+            collectJourneys(departureTime);
+        }
+        std::reverse(profile.begin(), profile.end());
+        if (Debug) totalTime += totalTimer.elapsedMicroseconds();
+    }
+
+    inline const std::vector<ProfileJourney>& getProfile() const noexcept {
+        return profile;
+    }
+
+    inline int getDirectTransferTime() const noexcept {
+        return directTransferTime;
+    }
+
+    inline std::vector<int> getDepartureTimes() const noexcept {
+        std::vector<int> result;
+        for (const DepartureLabel& departure : departures) {
+            if (!result.empty() && result.back() == departure.departureTime) continue;
+            result.emplace_back(departure.departureTime);
+        }
+        return result;
+    }
+
+    inline void debug(const double f = 1.0) noexcept {
+        std::cout << "Number of departure times: " << String::prettyDouble(departureTimeCount / f, 0) << std::endl;
+        std::cout << "Number of enqueued trips: " << String::prettyDouble(enqueueCount / f, 0) << std::endl;
+        std::cout << "Number of scanned trips: " << String::prettyDouble(scannedTripsCount / f, 0) << std::endl;
+        std::cout << "Number of scanned stops: " << String::prettyDouble(scannedStopsCount / f, 0) << std::endl;
+        std::cout << "Number of scanned shortcuts: " << String::prettyDouble(scannedShortcutCount / f, 0) << std::endl;
+        std::cout << "Number of rounds: " << String::prettyDouble(roundCount / f, 2) << std::endl;
+        std::cout << "Number of found journeys: " << String::prettyDouble(addJourneyCount / f, 0) << std::endl;
+        std::cout << "Number of profile journeys: " << String::prettyDouble(profileJourneyCount / f, 0) << std::endl;
+        std::cout << "Bucket-CH query time: " << String::musToString(chTime / f) << std::endl;
+        std::cout << "Initial transfer evaluation time: " << String::musToString(initialTime / f) << std::endl;
+        std::cout << "Trip scanning time: " << String::musToString(scanTime / f) << std::endl;
+        std::cout << "total time: " << String::musToString(totalTime / f) << std::endl;
+        departureTimeCount = 0;
+        addJourneyCount = 0;
+        profileJourneyCount = 0;
+        enqueueCount = 0;
+        scannedTripsCount = 0;
+        scannedStopsCount = 0;
+        scannedShortcutCount = 0;
+        roundCount = 0;
+        chTime = 0.0;
+        initialTime = 0.0;
+        scanTime = 0.0;
+        totalTime = 0.0;
+    }
+
+private:
+    inline void clear() noexcept {
+        currentQueue.clear();
+        nextQueue.clear();
+        for (ReachedIndex& reachedIndex : reachedIndices) {
+            reachedIndex.clear();
+        }
+        departures.clear();
+        profile.clear();
+        numberOfUsedVehicles = 0;
+        minArrivalTime = INFTY;
+        directTransferTime = INFTY;
+        minArrivalTimeByMaxNumberOfUsedVehicles.assign(1, INFTY);
+    }
+
+    inline void computeInitialAndFinalTransfers(const Vertex source, const Vertex target) noexcept {
+        if (Debug) chTimer.restart();
+        bucketQuery.run(source, target);
+        directTransferTime = bucketQuery.getDistance();
+        for (const Vertex stop : bucketQuery.getForwardPOIs()) {
+            for (const RAPTOR::RouteSegment& route : data.raptorData.routesContainingStop(StopId(stop))) {
+                reachedRoutes[route.routeId] = true;
+            }
+        }
+        if (Debug) chTime += chTimer.elapsedMicroseconds();
+    }
+
+    inline void collectDepartures(const int minDepartureTime, const int maxDepartureTime) noexcept {
+        if (Debug) initialTimer.restart();
+        for (const RouteId route : data.raptorData.routes()) {
+            if (!reachedRoutes[route]) continue;
+            const RouteLabel& label = routeLabels[route];
+            const int* departureTimes = data.departureTimesOfRoute(route);
+            const StopIndex endIndex = label.end();
+            const TripId firstTrip = data.firstTripOfRoute[route];
+            const StopId* stops = data.raptorData.stopArrayOfRoute(route);
+            for (StopIndex stopIndex(0); stopIndex < endIndex; stopIndex++) {
+                const int timeFromSource = bucketQuery.getForwardDistance(stops[stopIndex]);
+                if (timeFromSource == INFTY) continue;
+                const u_int32_t labelIndex = stopIndex * label.numberOfTrips;
+                TripId tripIndex = std::lower_bound(TripId(0), TripId(label.numberOfTrips), minDepartureTime + timeFromSource, [&](const TripId trip, const int time) {
+                    return departureTimes[labelIndex + trip] < time;
+                });
+                for (; tripIndex < label.numberOfTrips; tripIndex++) {
+                    const int departureTime = departureTimes[labelIndex + tripIndex] - timeFromSource;
+                    if (departureTime > maxDepartureTime) break;
+                    departures.emplace_back(departureTime, firstTrip + tripIndex, stopIndex);
+                }
+            }
+        }
+        std::sort(departures.begin(), departures.end());
+        if (Debug) initialTime += initialTimer.elapsedMicroseconds();
+    }
+
+    // Enqueues the earliest reachable trips for a departure after the range, such that all journeys that do not
+    // depart within the range are dominated.
+    inline void evaluateInitialTransfers(const int departureTime) noexcept {
+        if (Debug) initialTimer.restart();
+        startNewDepartureTime(departureTime);
+        for (const RouteId route : data.raptorData.routes()) {
+            if (!reachedRoutes[route]) continue;
+            reachedRoutes[route] = false;
+            const RouteLabel& label = routeLabels[route];
+            const int* departureTimes = data.departureTimesOfRoute(route);
+            const StopIndex endIndex = label.end();
+            const TripId firstTrip = data.firstTripOfRoute[route];
+            const StopId* stops = data.raptorData.stopArrayOfRoute(route);
+            TripId tripIndex = noTripId;
+            for (StopIndex stopIndex(0); stopIndex < endIndex; stopIndex++) {
+                const int timeFromSource = bucketQuery.getForwardDistance(stops[stopIndex]);
+                if (timeFromSource == INFTY) continue;
+                const u_int32_t labelIndex = stopIndex * label.numberOfTrips;
+                if (tripIndex >= label.numberOfTrips) {
+                    tripIndex = std::lower_bound(TripId(0), TripId(label.numberOfTrips), departureTime + timeFromSource, [&](const TripId trip, const int time) {
+                        return departureTimes[labelIndex + trip] < time;
+                    });
+                    if (tripIndex >= label.numberOfTrips) continue;
+                } else {
+                    const int stopDepartureTime = departureTime + timeFromSource;
+                    if (departureTimes[labelIndex + tripIndex - 1] < stopDepartureTime) continue;
+                    tripIndex--;
+                    while ((tripIndex > 0) && (departureTimes[labelIndex + tripIndex - 1] >= stopDepartureTime)) {
+                        tripIndex--;
+                    }
+                }
+                enqueue(firstTrip + tripIndex, stopIndex);
+                if (tripIndex == 0) break;
+            }
+        }
+        if (Debug) initialTime += initialTimer.elapsedMicroseconds();
+    }
+
+    inline void startNewDepartureTime(const int departureTime) noexcept {
+        if constexpr (Debug) departureTimeCount++;
+        numberOfUsedVehicles = 0;
+        minArrivalTime = minArrivalTimeByMaxNumberOfUsedVehicles[0];
+        if (directTransferTime != INFTY) {
+            addJourney(departureTime + directTransferTime);
+        }
+    }
+
+    inline void scanTrips() noexcept {
+        if (Debug) scanTimer.restart();
+        while (!nextQueue.empty()) {
+            if constexpr (Debug) roundCount++;
+            currentQueue.swap(nextQueue);
+            numberOfUsedVehicles++;
+            minArrivalTime = getMinArrivalTime(numberOfUsedVehicles);
+            for (const TripLabel& label : currentQueue) { // Evaluate final transfers in order to check if the target is reachable
+                if constexpr (Debug) scannedTripsCount++;
+                for (StopEventId i(label.begin); i < label.end; i++) {
+                    if constexpr (Debug) scannedStopsCount++;
+                    if (data.arrivalEvents[i].arrivalTime >= minArrivalTime) break;
+                    const int timeToTarget = bucketQuery.getBackwardDistance(data.arrivalEvents[i].stop);
+                    if (timeToTarget != INFTY) addJourney(data.arrivalEvents[i].arrivalTime + timeToTarget);
+                }
+            }
+            for (TripLabel& label : currentQueue) { // Find the range of transfers for each trip
+                for (StopEventId i(label.begin); i < label.end; i++) {
+                    if (data.arrivalEvents[i].arrivalTime >= minArrivalTime) label.end = i;
+                }
+                label.begin = data.stopEventGraph.beginEdgeFrom(Vertex(label.begin));
+                label.end = data.stopEventGraph.beginEdgeFrom(Vertex(label.end));
+            }
+            for (const TripLabel& label : currentQueue) { // Relax the transfers for each trip
+                for (Edge edge(label.begin); edge < label.end; edge++) {
+                    if constexpr (Debug) scannedShortcutCount++;
+                    enqueue(edge);
+                }
+            }
+            currentQueue.clear();
+        }
+        if (Debug) scanTime += scanTimer.elapsedMicroseconds();
+    }
+
+    inline void collectJourneys(const int departureTime) noexcept {
+        for (size_t i = 1; i < minArrivalTimeByMaxNumberOfUsedVehicles.size(); i++) {
+            const int arrivalTime = minArrivalTimeByMaxNumberOfUsedVehicles[i];
+            if (arrivalTime >= minArrivalTimeByMaxNumberOfUsedVehicles[i - 1]) continue;
+            const int previousArrivalTime = (i < previousMinArrivalTimes.size()) ? previousMinArrivalTimes[i] : previousMinArrivalTimes.back();
+            if (arrivalTime >= previousArrivalTime) continue;
+            if constexpr (Debug) profileJourneyCount++;
+            profile.emplace_back(departureTime, arrivalTime, i);
+        }
+        previousMinArrivalTimes = minArrivalTimeByMaxNumberOfUsedVehicles;
+    }
+
+    inline ReachedIndex& getReachedIndex(const size_t round) noexcept {
+        while (round >= reachedIndices.size()) {
+            reachedIndices.emplace_back(reachedIndices.back());
+        }
+        return reachedIndices[round];
+    }
+
+    // A trip that is reached in some round is also reached in all later rounds.
+    inline void updateReachedIndices(const size_t round, const TripId trip, const StopIndex index) noexcept {
+        for (size_t i = round; i < reachedIndices.size(); i++) {
+            if (reachedIndices[i].alreadyReached(trip, index)) break;
+            reachedIndices[i].update(trip, index);
+        }
+    }
+
+    inline void enqueue(const TripId trip, const StopIndex index) noexcept {
+        if constexpr (Debug) enqueueCount++;
+        ReachedIndex& reachedIndex = getReachedIndex(numberOfUsedVehicles);
+        if (reachedIndex.alreadyReached(trip, index + 1)) return;
+        const StopEventId firstEvent = data.firstStopEventOfTrip[trip];
+        nextQueue.emplace_back(firstEvent + index + 1, firstEvent + reachedIndex(trip));
+        updateReachedIndices(numberOfUsedVehicles, trip, index);
+    }
+
+    inline void enqueue(const Edge edge) noexcept {
+        if constexpr (Debug) enqueueCount++;
+        const EdgeLabel& label = edgeLabels[edge];
+        ReachedIndex& reachedIndex = getReachedIndex(numberOfUsedVehicles);
+        if (reachedIndex.alreadyReached(label.trip, label.stopEvent - label.firstEvent)) return;
+        nextQueue.emplace_back(label.stopEvent, StopEventId(label.firstEvent + reachedIndex(label.trip)));
+        updateReachedIndices(numberOfUsedVehicles, label.trip, StopIndex(label.stopEvent - label.firstEvent));
+    }
+
+    inline int getMinArrivalTime(const size_t maxNumberOfUsedVehicles) const noexcept {
+        if (maxNumberOfUsedVehicles < minArrivalTimeByMaxNumberOfUsedVehicles.size()) {
+            return minArrivalTimeByMaxNumberOfUsedVehicles[maxNumberOfUsedVehicles];
+        } else {
+            return minArrivalTimeByMaxNumberOfUsedVehicles.back();
+        }
+    }
+
+    // In contrast to the single-criterion query, the bounds for more trips may already be set by a later departure
+    // time, so a new journey has to be propagated to all of them.
+    inline void addJourney(const int newArrivalTime) noexcept {
+        if constexpr (Debug) addJourneyCount++;
+        if (numberOfUsedVehicles >= minArrivalTimeByMaxNumberOfUsedVehicles.size()) {
+            minArrivalTimeByMaxNumberOfUsedVehicles.resize(numberOfUsedVehicles + 1, minArrivalTimeByMaxNumberOfUsedVehicles.back());
+        }
+        for (size_t i = numberOfUsedVehicles; i < minArrivalTimeByMaxNumberOfUsedVehicles.size(); i++) {
+            if (minArrivalTimeByMaxNumberOfUsedVehicles[i] <= newArrivalTime) break;
+            minArrivalTimeByMaxNumberOfUsedVehicles[i] = newArrivalTime;
+        }
+        minArrivalTime = minArrivalTimeByMaxNumberOfUsedVehicles[numberOfUsedVehicles];
+    }
+
+private:
+    const Data& data;
+
+    CH::BucketQuery<CHGraph, true, false> bucketQuery;
+    std::vector<TripLabel> currentQueue;
+    std::vector<TripLabel> nextQueue;
+    std::vector<ReachedIndex> reachedIndices;
+    std::vector<bool> reachedRoutes;
+    std::vector<DepartureLabel> departures;
+
+    int minArrivalTime;
+    int directTransferTime;
+    u_int32_t numberOfUsedVehicles;
+    std::vector<int> minArrivalTimeByMaxNumberOfUsedVehicles;
+    std::vector<int> previousMinArrivalTimes;
+    std::vector<ProfileJourney> profile;
+
+    const MappedVector<EdgeLabel>& edgeLabels;
+    const std::vector<RouteLabel>& routeLabels;
+
+    size_t departureTimeCount{0};
+    size_t addJourneyCount{0};
+    size_t profileJourneyCount{0};
+    size_t enqueueCount{0};
+    size_t scannedTripsCount{0};
+    size_t scannedStopsCount{0};
+    size_t scannedShortcutCount{0};
+    size_t roundCount{0};
+    Timer chTimer;
+    Timer initialTimer;
+    Timer scanTimer;
+    Timer totalTimer;
+    double chTime{0.0};
+    double initialTime{0.0};
+    double scanTime{0.0};
+    double totalTime{0.0};
+
+};
+
+}
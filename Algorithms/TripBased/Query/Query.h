@@ -20,99 +20,153 @@
 
 #pragma once
 
-#include "ReachedIndexSmall.h"
+#include "LowerBoundTable.h"
+#include "ReachedIndex.h"
+#include "ReachedIndexTimestamp.h"
 
 #include "../../CH/Query/BucketQuery.h"
 
 #include "../../../DataStructures/TripBased/Data.h"
 
+#include "../../../Helpers/AllocationCounter.h"
+
 namespace TripBased {
 
+struct JourneyLeg {
+    JourneyLeg(const Vertex from = noVertex, const Vertex to = noVertex, const int departureTime = never, const int arrivalTime = never, const StopEventId departureEvent = noStopEvent, const StopEventId arrivalEvent = noStopEvent, const TripId trip = noTripId) :
+        from(from),
+        to(to),
+        departureTime(departureTime),
+        arrivalTime(arrivalTime),
+        departureEvent(departureEvent),
+        arrivalEvent(arrivalEvent),
+        trip(trip) {
+    }
+    inline bool usesTrip() const noexcept {
+        return trip != noTripId;
+    }
+    inline friend std::ostream& operator<<(std::ostream& out, const JourneyLeg& l) noexcept {
+        if (l.usesTrip()) {
+            return out << "trip " << l.trip << " from " << l.from << " (event " << l.departureEvent << ", " << String::secToTime(l.departureTime) << ") to " << l.to << " (event " << l.arrivalEvent << ", " << String::secToTime(l.arrivalTime) << ")";
+        } else {
+            return out << "walk from " << l.from << " (" << String::secToTime(l.departureTime) << ") to " << l.to << " (" << String::secToTime(l.arrivalTime) << ")";
+        }
+    }
+    Vertex from;
+    Vertex to;
+    int departureTime;
+    int arrivalTime;
+    StopEventId departureEvent;
+    StopEventId arrivalEvent;
+    TripId trip;
+};
+
 struct Journey {
     Journey(const int arrivalTime, const u_int32_t numberOfUsedVehicles) :
         arrivalTime(arrivalTime),
         numberOfUsedVehicles(numberOfUsedVehicles) {
     }
     inline friend std::ostream& operator<<(std::ostream& out, const Journey& j) noexcept {
-        return out << "arrivalTime: " << j.arrivalTime << ", numberOfUsedVehicles: " << j.numberOfUsedVehicles;
+        out << "arrivalTime: " << j.arrivalTime << ", numberOfUsedVehicles: " << j.numberOfUsedVehicles;
+        for (const JourneyLeg& leg : j.legs) {
+            out << std::endl << "    " << leg;
+        }
+        return out;
     }
     int arrivalTime;
     u_int32_t numberOfUsedVehicles;
+    std::vector<JourneyLeg> legs;
 };
 
-template<typename REACHED_INDEX, bool DEBUG = false>
+// If TRACK_PARENTS is set, every enqueued trip remembers the trip and shortcut it was reached from, such that
+// getJourneys() can reconstruct the legs of the journeys.
+// If LOWER_BOUND_PRUNING is set, a table of lower bounds for the travel time from every stop to the target is computed
+// for each target (see LowerBoundTable). Trips and transfers are pruned if the arrival time plus the lower bound is not
+// smaller than the best known arrival time.
+// If ARC_FLAGS is set, only shortcuts whose arc flags contain the cell of a stop from which the target can be reached by
+// walking are relaxed (see ArcFlagBuilder).
+template<typename REACHED_INDEX, bool DEBUG = false, bool TRACK_PARENTS = false, bool LOWER_BOUND_PRUNING = false, bool ARC_FLAGS = false>
 class Query {
 
 public:
     using ReachedIndex = REACHED_INDEX;
     static constexpr bool Debug = DEBUG;
-    using Type = Query<ReachedIndex, Debug>;
+    static constexpr bool TrackParents = TRACK_PARENTS;
+    static constexpr bool LowerBoundPruning = LOWER_BOUND_PRUNING;
+    static constexpr bool ArcFlags = ARC_FLAGS;
+    using Type = Query<ReachedIndex, Debug, TrackParents, LowerBoundPruning, ArcFlags>;
+    using DebugType = Query<ReachedIndex, true, TrackParents, LowerBoundPruning, ArcFlags>;
 
 private:
+    static constexpr u_int32_t NoParent = -1;
+
     struct TripLabel {
-        TripLabel(const u_int32_t begin, const u_int32_t end) :
+        TripLabel(const u_int32_t begin, const u_int32_t end, const u_int32_t parent = NoParent) :
             begin(begin),
-            end(end) {
+            end(end),
+            parent(parent) {
         }
         u_int32_t begin;
         u_int32_t end;
+        u_int32_t parent; // Index of the ParentLabel describing how the trip was reached.
     };
 
-    struct EdgeLabel {
-        EdgeLabel(const StopEventId stopEvent = noStopEvent, const TripId trip = noTripId, const StopEventId firstEvent = noStopEvent) :
-            stopEvent(stopEvent),
-            trip(trip),
-            firstEvent(firstEvent) {
+    struct ParentLabel {
+        ParentLabel(const StopEventId departureEvent = noStopEvent, const Edge edge = noEdge, const u_int32_t parent = NoParent) :
+            departureEvent(departureEvent),
+            edge(edge),
+            parent(parent) {
         }
-        StopEventId stopEvent;
-        TripId trip;
-        StopEventId firstEvent;
+        StopEventId departureEvent;
+        Edge edge; // The shortcut used to reach the trip, or noEdge for the initial transfer.
+        u_int32_t parent;
     };
 
-    struct RouteLabel {
-        RouteLabel() :
-            numberOfTrips(0) {
+    struct TargetLabel {
+        TargetLabel(const u_int32_t parent = NoParent, const StopEventId arrivalEvent = noStopEvent) :
+            parent(parent),
+            arrivalEvent(arrivalEvent) {
         }
-        inline StopIndex end() const noexcept {
-            return StopIndex(departureTimes.size() / numberOfTrips);
-        }
-        u_int32_t numberOfTrips;
-        std::vector<int> departureTimes;
+        u_int32_t parent;
+        StopEventId arrivalEvent;
     };
 
 public:
     Query(const Data& data, const CH::CH& chData) :
+        Query(data, chData, CH::BucketQuery<CHGraph, true, false>::buildBucketGraph(chData.forward, chData.backward, chData.forward[Weight], chData.backward[Weight], data.numberOfStops())) {
+    }
+
+    Query(const Data& data, const CH::CH& chData, const std::shared_ptr<const CH::BucketGraph>& bucketGraph) :
         data(data),
-        bucketQuery(chData.forward, chData.backward, data.numberOfStops(), Weight),
+        bucketQuery(chData.forward, chData.backward, bucketGraph, Weight),
         reachedIndex(data),
-        edgeLabels(data.stopEventGraph.numEdges()),
-        routeLabels(data.numberOfRoutes()) {
-        for (const Edge edge : data.stopEventGraph.edges()) {
-            edgeLabels[edge].stopEvent = StopEventId(data.stopEventGraph.get(ToVertex, edge) + 1);
-            edgeLabels[edge].trip = data.tripOfStopEvent[data.stopEventGraph.get(ToVertex, edge)];
-            edgeLabels[edge].firstEvent = data.firstStopEventOfTrip[edgeLabels[edge].trip];
-        }
-        for (const RouteId route : data.raptorData.routes()) {
-            const size_t numberOfStops = data.numberOfStopsInRoute(route);
-            const size_t numberOfTrips = data.raptorData.numberOfTripsInRoute(route);
-            const RAPTOR::StopEvent* stopEvents = data.raptorData.firstTripOfRoute(route);
-            routeLabels[route].numberOfTrips = numberOfTrips;
-            routeLabels[route].departureTimes.resize((numberOfStops - 1) * numberOfTrips);
-            for (size_t trip = 0; trip < numberOfTrips; trip++) {
-                for (size_t stopIndex = 0; stopIndex + 1 < numberOfStops; stopIndex++) {
-                    routeLabels[route].departureTimes[(stopIndex * numberOfTrips) + trip] = stopEvents[(trip * numberOfStops) + stopIndex].departureTime;
-                }
-            }
-        }
+        reachedRoutes(data.numberOfRoutes(), false),
+        edgeLabels(data.edgeLabels),
+        routeLabels(data.routeLabels) {
+        AssertMsg(data.hasQueryLabels(), "The query labels of the Trip-Based data are missing!");
+        if constexpr (LowerBoundPruning) lowerBounds = std::make_unique<LowerBoundTable>(data, chData, bucketGraph);
+        if constexpr (ArcFlags) Ensure(data.hasArcFlags(), "The arc flags of the Trip-Based data are missing!");
     }
 
     inline void run(const Vertex source, const int departureTime, const Vertex target) noexcept {
+        const size_t allocationsAtStart = Debug ? AllocationCounter::count() : 0;
         if (Debug) totalTimer.restart();
         clear();
+        if constexpr (TrackParents) {
+            sourceVertex = source;
+            targetVertex = target;
+            sourceDepartureTime = departureTime;
+        }
         computeInitialAndFinalTransfers(source, departureTime, target);
+        if constexpr (LowerBoundPruning) computeLowerBounds(target);
         evaluateInitialTransfers(departureTime);
         scanTrips();
-        if (Debug) totalTime += totalTimer.elapsedMicroseconds();
+        if (Debug) {
+            totalTime += totalTimer.elapsedMicroseconds();
+            const size_t allocations = AllocationCounter::count() - allocationsAtStart;
+            allocationCount += allocations;
+            if (allocations > 0) allocatingQueryCount++;
+        }
     }
 
     inline int getEarliestArrivalTime() const noexcept {
@@ -133,6 +187,7 @@ public:
             if (minArrivalTimeByMaxNumberOfUsedVehicles[i] >= INFTY) continue;
             if ((result.size() >= 1) && (result.back().arrivalTime == minArrivalTimeByMaxNumberOfUsedVehicles[i])) continue;
             result.emplace_back(minArrivalTimeByMaxNumberOfUsedVehicles[i], i);
+            if constexpr (TrackParents) getLegs(targetLabelByMaxNumberOfUsedVehicles[i], result.back().arrivalTime, result.back().legs);
         }
         return result;
     }
@@ -146,8 +201,19 @@ public:
         std::cout << "Number of found journeys: " << String::prettyDouble(addJourneyCount / f, 0) << std::endl;
         std::cout << "Number of initial transfers: " << String::prettyDouble(initialTransferCount / f, 0) << std::endl;
         std::cout << "Bucket-CH query time: " << String::musToString(chTime / f) << std::endl;
+        if constexpr (LowerBoundPruning) {
+            std::cout << "Number of pruned trips: " << String::prettyDouble(prunedTripsCount / f, 0) << std::endl;
+            std::cout << "Lower bound computation time: " << String::musToString(lowerBoundTime / f) << std::endl;
+        }
+        if constexpr (ArcFlags) {
+            std::cout << "Number of shortcuts pruned by arc flags: " << String::prettyDouble(prunedShortcutCount / f, 0) << std::endl;
+        }
         std::cout << "Initial transfer evaluation time: " << String::musToString(initialTime / f) << std::endl;
         std::cout << "Trip scanning time: " << String::musToString(scanTime / f) << std::endl;
+        if constexpr (AllocationCounter::Enabled) {
+            std::cout << "Number of heap allocations: " << String::prettyDouble(allocationCount / f, 2) << std::endl;
+            std::cout << "Queries with heap allocations: " << String::prettyInt(allocatingQueryCount) << std::endl;
+        }
         std::cout << "total time: " << String::musToString(totalTime / f) << std::endl;
         addJourneyCount = 0;
         enqueueCount = 0;
@@ -156,7 +222,12 @@ public:
         scannedShortcutCount = 0;
         roundCount = 0;
         initialTransferCount = 0;
+        allocationCount = 0;
+        allocatingQueryCount = 0;
+        prunedTripsCount = 0;
+        prunedShortcutCount = 0;
         chTime = 0.0;
+        lowerBoundTime = 0.0;
         initialTime = 0.0;
         scanTime = 0.0;
         totalTime = 0.0;
@@ -169,7 +240,11 @@ private:
         reachedIndex.clear();
         numberOfUsedVehicles = 0;
         minArrivalTime = INFTY;
-        std::vector<int>(1, INFTY).swap(minArrivalTimeByMaxNumberOfUsedVehicles);
+        minArrivalTimeByMaxNumberOfUsedVehicles.assign(1, INFTY);
+        if constexpr (TrackParents) {
+            parentLabels.clear();
+            targetLabelByMaxNumberOfUsedVehicles.assign(1, TargetLabel());
+        }
     }
 
     inline void computeInitialAndFinalTransfers(const Vertex source, const int departureTime, const Vertex target) noexcept {
@@ -178,12 +253,34 @@ private:
         if (bucketQuery.getDistance() != INFTY) {
             addJourney(departureTime + bucketQuery.getDistance());
         }
+        if constexpr (ArcFlags) {
+            targetCells = 0;
+            for (const Vertex stop : bucketQuery.getBackwardPOIs()) {
+                targetCells |= u_int64_t(1) << data.cellOfStop[stop];
+            }
+        }
         if (Debug) chTime += chTimer.elapsedMicroseconds();
     }
 
+    inline void computeLowerBounds(const Vertex target) noexcept {
+        if (Debug) lowerBoundTimer.restart();
+        lowerBounds->run(target);
+        if (Debug) lowerBoundTime += lowerBoundTimer.elapsedMicroseconds();
+    }
+
+    // A trip (or the transfers of a stop event) can be pruned if the target cannot be reached before the best known
+    // arrival time, even with the travel time from the given arrival event to the target being as low as its bound.
+    inline bool prune(const StopEventId arrivalEvent) const noexcept {
+        if constexpr (LowerBoundPruning) {
+            return data.arrivalEvents[arrivalEvent].arrivalTime + (*lowerBounds)[data.arrivalEvents[arrivalEvent].stop] >= minArrivalTime;
+        } else {
+            suppressUnusedParameterWarning(arrivalEvent);
+            return false;
+        }
+    }
+
     inline void evaluateInitialTransfers(const int departureTime) noexcept {
         if (Debug) initialTimer.restart();
-        std::vector<bool> reachedRoutes(data.raptorData.numberOfRoutes(), false);
         for (const Vertex stop : bucketQuery.getForwardPOIs()) {
             for (const RAPTOR::RouteSegment& route : data.raptorData.routesContainingStop(StopId(stop))) {
                 reachedRoutes[route.routeId] = true;
@@ -191,7 +288,9 @@ private:
         }
         for (const RouteId route : data.raptorData.routes()) {
             if (!reachedRoutes[route]) continue;
+            reachedRoutes[route] = false;
             const RouteLabel& label = routeLabels[route];
+            const int* departureTimes = data.departureTimesOfRoute(route);
             const StopIndex endIndex = label.end();
             const TripId firstTrip = data.firstTripOfRoute[route];
             const StopId* stops = data.raptorData.stopArrayOfRoute(route);
@@ -202,14 +301,14 @@ private:
                 const u_int32_t labelIndex = stopIndex * label.numberOfTrips;
                 if (tripIndex >= label.numberOfTrips) {
                     tripIndex = std::lower_bound(TripId(0), TripId(label.numberOfTrips), departureTime + timeFromSource, [&](const TripId trip, const int time) {
-                        return label.departureTimes[labelIndex + trip] < time;
+                        return departureTimes[labelIndex + trip] < time;
                     });
                     if (tripIndex >= label.numberOfTrips) continue;
                 } else {
                     const int stopDepartureTime = departureTime + timeFromSource;
-                    if (label.departureTimes[labelIndex + tripIndex - 1] < stopDepartureTime) continue;
+                    if (departureTimes[labelIndex + tripIndex - 1] < stopDepartureTime) continue;
                     tripIndex--;
-                    while ((tripIndex > 0) && (label.departureTimes[labelIndex + tripIndex - 1] >= stopDepartureTime)) {
+                    while ((tripIndex > 0) && (departureTimes[labelIndex + tripIndex - 1] >= stopDepartureTime)) {
                         tripIndex--;
                     }
                 }
@@ -232,20 +331,31 @@ private:
                     if constexpr (Debug) scannedStopsCount++;
                     if (data.arrivalEvents[i].arrivalTime >= minArrivalTime) break;
                     const int timeToTarget = bucketQuery.getBackwardDistance(data.arrivalEvents[i].stop);
-                    if (timeToTarget != INFTY) addJourney(data.arrivalEvents[i].arrivalTime + timeToTarget);
+                    if (timeToTarget != INFTY) addJourney(data.arrivalEvents[i].arrivalTime + timeToTarget, label.parent, i);
                 }
             }
             for (TripLabel& label : currentQueue) { // Find the range of transfers for each trip
                 for (StopEventId i(label.begin); i < label.end; i++) {
                     if (data.arrivalEvents[i].arrivalTime >= minArrivalTime) label.end = i;
                 }
+                if constexpr (LowerBoundPruning) continue; // The transfers are pruned per stop event below
                 label.begin = data.stopEventGraph.beginEdgeFrom(Vertex(label.begin));
                 label.end = data.stopEventGraph.beginEdgeFrom(Vertex(label.end));
             }
             for (const TripLabel& label : currentQueue) { // Relax the transfers for each trip
-                for (Edge edge(label.begin); edge < label.end; edge++) {
-                    if constexpr (Debug) scannedShortcutCount++;
-                    enqueue(edge);
+                if constexpr (LowerBoundPruning) {
+                    for (StopEventId i(label.begin); i < label.end; i++) {
+                        if (prune(i)) continue;
+                        for (const Edge edge : data.stopEventGraph.edgesFrom(Vertex(i))) {
+                            if constexpr (Debug) scannedShortcutCount++;
+                            enqueue(edge, label.parent);
+                        }
+                    }
+                } else {
+                    for (Edge edge(label.begin); edge < label.end; edge++) {
+                        if constexpr (Debug) scannedShortcutCount++;
+                        enqueue(edge, label.parent);
+                    }
                 }
             }
             currentQueue.clear();
@@ -257,28 +367,104 @@ private:
         if constexpr (Debug) enqueueCount++;
         if (reachedIndex.alreadyReached(trip, index + 1)) return;
         const StopEventId firstEvent = data.firstStopEventOfTrip[trip];
-        nextQueue.emplace_back(firstEvent + index + 1, firstEvent + reachedIndex(trip));
+        if (prune(StopEventId(firstEvent + index + 1))) {
+            if constexpr (Debug) prunedTripsCount++;
+            return;
+        }
+        nextQueue.emplace_back(firstEvent + index + 1, firstEvent + reachedIndex(trip), addParentLabel(StopEventId(firstEvent + index), noEdge, NoParent));
         reachedIndex.update(trip, index);
     }
 
-    inline void enqueue(const Edge edge) noexcept {
+    inline void enqueue(const Edge edge, const u_int32_t parent) noexcept {
         if constexpr (Debug) enqueueCount++;
+        if constexpr (ArcFlags) {
+            if (!(data.getArcFlags(edge) & targetCells)) {
+                if constexpr (Debug) prunedShortcutCount++;
+                return;
+            }
+        }
         const EdgeLabel& label = edgeLabels[edge];
         if (reachedIndex.alreadyReached(label.trip, label.stopEvent - label.firstEvent)) return;
-        nextQueue.emplace_back(label.stopEvent, StopEventId(label.firstEvent + reachedIndex(label.trip)));
+        if (prune(label.stopEvent)) {
+            if constexpr (Debug) prunedTripsCount++;
+            return;
+        }
+        nextQueue.emplace_back(label.stopEvent, StopEventId(label.firstEvent + reachedIndex(label.trip)), addParentLabel(StopEventId(label.stopEvent - 1), edge, parent));
         reachedIndex.update(label.trip, StopIndex(label.stopEvent - label.firstEvent));
     }
 
-    inline void addJourney(const int newArrivalTime) noexcept {
+    inline u_int32_t addParentLabel(const StopEventId departureEvent, const Edge edge, const u_int32_t parent) noexcept {
+        if constexpr (TrackParents) {
+            parentLabels.emplace_back(departureEvent, edge, parent);
+            return parentLabels.size() - 1;
+        } else {
+            suppressUnusedParameterWarning(departureEvent);
+            suppressUnusedParameterWarning(edge);
+            suppressUnusedParameterWarning(parent);
+            return NoParent;
+        }
+    }
+
+    inline void addJourney(const int newArrivalTime, const u_int32_t parent = NoParent, const StopEventId arrivalEvent = noStopEvent) noexcept {
         if constexpr (Debug) addJourneyCount++;
         if (numberOfUsedVehicles >= minArrivalTimeByMaxNumberOfUsedVehicles.size()) {
             minArrivalTimeByMaxNumberOfUsedVehicles.resize(numberOfUsedVehicles + 1, minArrivalTimeByMaxNumberOfUsedVehicles.back());
+            if constexpr (TrackParents) targetLabelByMaxNumberOfUsedVehicles.resize(numberOfUsedVehicles + 1, targetLabelByMaxNumberOfUsedVehicles.back());
         }
         AssertMsg(numberOfUsedVehicles + 1 == minArrivalTimeByMaxNumberOfUsedVehicles.size(), "Wrong number of used vehicles!");
+        if constexpr (TrackParents) {
+            if (newArrivalTime < minArrivalTimeByMaxNumberOfUsedVehicles[numberOfUsedVehicles]) {
+                targetLabelByMaxNumberOfUsedVehicles[numberOfUsedVehicles] = TargetLabel(parent, arrivalEvent);
+            }
+        } else {
+            suppressUnusedParameterWarning(parent);
+            suppressUnusedParameterWarning(arrivalEvent);
+        }
         minArrivalTimeByMaxNumberOfUsedVehicles[numberOfUsedVehicles] = std::min(minArrivalTimeByMaxNumberOfUsedVehicles[numberOfUsedVehicles], newArrivalTime);
         minArrivalTime = minArrivalTimeByMaxNumberOfUsedVehicles[numberOfUsedVehicles];
     }
 
+    // Follows the parent pointers from the target back to the source. The stop event graph does not store the walking
+    // time of a shortcut, therefore an intermediate walking leg ends with the departure of the next trip.
+    inline void getLegs(const TargetLabel& targetLabel, const int arrivalTime, std::vector<JourneyLeg>& legs) const noexcept {
+        if (targetLabel.parent == NoParent) {
+            legs.emplace_back(sourceVertex, targetVertex, sourceDepartureTime, arrivalTime);
+            return;
+        }
+        const Vertex finalStop = data.getStopOfStopEvent(targetLabel.arrivalEvent);
+        if (finalStop != targetVertex) {
+            legs.emplace_back(finalStop, targetVertex, data.arrivalEvents[targetLabel.arrivalEvent].arrivalTime, arrivalTime);
+        }
+        StopEventId arrivalEvent = targetLabel.arrivalEvent;
+        for (u_int32_t i = targetLabel.parent; i != NoParent; i = parentLabels[i].parent) {
+            const ParentLabel& label = parentLabels[i];
+            const Vertex departureStop = data.getStopOfStopEvent(label.departureEvent);
+            const int departureTime = data.raptorData.stopEvents[label.departureEvent].departureTime;
+            legs.emplace_back(departureStop, data.getStopOfStopEvent(arrivalEvent), departureTime, data.arrivalEvents[arrivalEvent].arrivalTime, label.departureEvent, arrivalEvent, data.tripOfStopEvent[label.departureEvent]);
+            if (label.edge == noEdge) {
+                if (departureStop != sourceVertex) {
+                    legs.emplace_back(sourceVertex, departureStop, sourceDepartureTime, sourceDepartureTime + bucketQuery.getForwardDistance(departureStop));
+                }
+            } else {
+                arrivalEvent = getFromStopEvent(label.edge, parentLabels[label.parent].departureEvent);
+                const Vertex transferStop = data.getStopOfStopEvent(arrivalEvent);
+                if (transferStop != departureStop) {
+                    legs.emplace_back(transferStop, departureStop, data.arrivalEvents[arrivalEvent].arrivalTime, departureTime);
+                }
+            }
+        }
+        std::reverse(legs.begin(), legs.end());
+    }
+
+    // Finds the stop event of the trip departing at departureEvent whose outgoing shortcuts contain edge.
+    inline StopEventId getFromStopEvent(const Edge edge, const StopEventId departureEvent) const noexcept {
+        const StopEventId tripEnd = data.firstStopEventOfTrip[data.tripOfStopEvent[departureEvent] + 1];
+        const StopEventId stopEvent = std::upper_bound(StopEventId(departureEvent + 1), tripEnd, edge, [&](const Edge e, const StopEventId event) {
+            return e < data.stopEventGraph.beginEdgeFrom(Vertex(event));
+        });
+        return StopEventId(stopEvent - 1);
+    }
+
 private:
     const Data& data;
 
@@ -286,13 +472,23 @@ private:
     std::vector<TripLabel> currentQueue;
     std::vector<TripLabel> nextQueue;
     ReachedIndex reachedIndex;
+    std::vector<bool> reachedRoutes;
 
     int minArrivalTime;
     u_int32_t numberOfUsedVehicles;
     std::vector<int> minArrivalTimeByMaxNumberOfUsedVehicles;
 
-    std::vector<EdgeLabel> edgeLabels;
-    std::vector<RouteLabel> routeLabels;
+    const MappedVector<EdgeLabel>& edgeLabels;
+    const std::vector<RouteLabel>& routeLabels;
+
+    std::unique_ptr<LowerBoundTable> lowerBounds;
+    u_int64_t targetCells{0};
+
+    Vertex sourceVertex{noVertex};
+    Vertex targetVertex{noVertex};
+    int sourceDepartureTime{never};
+    std::vector<ParentLabel> parentLabels;
+    std::vector<TargetLabel> targetLabelByMaxNumberOfUsedVehicles;
 
     size_t addJourneyCount{0};
     size_t enqueueCount{0};
@@ -301,14 +497,20 @@ private:
     size_t scannedShortcutCount{0};
     size_t roundCount{0};
     size_t initialTransferCount{0};
+    size_t allocationCount{0};
+    size_t allocatingQueryCount{0};
+    size_t prunedTripsCount{0};
+    size_t prunedShortcutCount{0};
     Timer chTimer;
+    Timer lowerBoundTimer;
     Timer initialTimer;
     Timer scanTimer;
     Timer totalTimer;
-    double chTime;
-    double initialTime;
-    double scanTime;
-    double totalTime;
+    double chTime{0.0};
+    double lowerBoundTime{0.0};
+    double initialTime{0.0};
+    double scanTime{0.0};
+    double totalTime{0.0};
 
 };
 
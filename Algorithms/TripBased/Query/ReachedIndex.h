@@ -0,0 +1,122 @@
+/**********************************************************************************
+
+ Copyright (c) 2020 Tobias Zündorf
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+
+#include "../../../DataStructures/TripBased/Data.h"
+
+#include "../../../Helpers/Meta.h"
+
+namespace TripBased {
+
+template<typename LABEL>
+class ReachedIndexImplementation {
+
+public:
+    using Label = LABEL;
+    using Type = ReachedIndexImplementation<Label>;
+    // Number of labels that are updated at once, one cache line.
+    static constexpr size_t ChunkSize = 64 / sizeof(Label);
+
+public:
+    ReachedIndexImplementation(const Data& data) :
+        data(data),
+        labels(data.numberOfTrips(), -1),
+        defaultLabels(data.numberOfTrips(), -1) {
+        for (const TripId trip : data.trips()) {
+            if (data.numberOfStopsInTrip(trip) > std::numeric_limits<Label>::max()) warning("Trip ", trip, " has ", data.numberOfStopsInTrip(trip), " stops!");
+            defaultLabels[trip] = data.numberOfStopsInTrip(trip);
+        }
+    }
+
+public:
+    inline void clear() noexcept {
+        labels = defaultLabels;
+    }
+
+    inline StopIndex operator()(const TripId trip) const noexcept {
+        AssertMsg(trip < labels.size(), "Trip " << trip << " is out of bounds!");
+        return StopIndex(labels[trip]);
+    }
+
+    inline bool alreadyReached(const TripId trip, const Label index) const noexcept {
+        return labels[trip] <= index;
+    }
+
+    inline void update(const TripId trip, const StopIndex index) noexcept {
+        AssertMsg(trip < labels.size(), "Trip " << trip << " is out of bounds!");
+        updateLabels(labels.data(), trip, data.firstTripOfRoute[data.routeOfTrip[trip] + 1], index);
+    }
+
+    // The labels of the trips of a route are non-increasing, hence the trips that have to be updated form a prefix of
+    // the range [begin, end). The range is processed in chunks of branch-free minimum operations, which can be
+    // vectorized, and the update stops after the first chunk that ends with a label that was already small enough.
+    inline static void updateLabels(Label* const labels, const size_t begin, const size_t end, const StopIndex index) noexcept {
+        const Label label = index;
+        for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += ChunkSize) {
+            const size_t chunkEnd = std::min(chunkBegin + ChunkSize, end);
+            const bool done = labels[chunkEnd - 1] <= label;
+            for (size_t i = chunkBegin; i < chunkEnd; i++) {
+                labels[i] = std::min(labels[i], label);
+            }
+            if (done) break;
+        }
+    }
+
+private:
+    const Data& data;
+
+    std::vector<Label> labels;
+
+    std::vector<Label> defaultLabels;
+
+};
+
+using ReachedIndexSmall = ReachedIndexImplementation<u_int8_t>;
+using ReachedIndexMedium = ReachedIndexImplementation<u_int16_t>;
+using ReachedIndexLarge = ReachedIndexImplementation<u_int32_t>;
+
+inline size_t maxNumberOfStopsInTrip(const Data& data) noexcept {
+    size_t result = 0;
+    for (const RouteId route : data.raptorData.routes()) {
+        result = std::max(result, data.numberOfStopsInRoute(route));
+    }
+    return result;
+}
+
+// Calls function with Meta::ID<REACHED_INDEX<LABEL>>, where LABEL is the smallest label type that can represent the
+// stop indices of all trips. Thus, the label type is chosen once when the network is loaded, and the query is still
+// compiled for a fixed label type.
+template<template<typename> class REACHED_INDEX, typename FUNCTION>
+inline void chooseReachedIndex(const Data& data, const FUNCTION& function) noexcept {
+    const size_t maxNumberOfStops = maxNumberOfStopsInTrip(data);
+    if (maxNumberOfStops <= std::numeric_limits<u_int8_t>::max()) {
+        function(Meta::ID<REACHED_INDEX<u_int8_t>>());
+    } else if (maxNumberOfStops <= std::numeric_limits<u_int16_t>::max()) {
+        function(Meta::ID<REACHED_INDEX<u_int16_t>>());
+    } else {
+        function(Meta::ID<REACHED_INDEX<u_int32_t>>());
+    }
+}
+
+}
@@ -0,0 +1,108 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include "ReachedIndex.h"
+
+#include "../../../DataStructures/TripBased/Data.h"
+
+namespace TripBased {
+
+// Same labels as ReachedIndexImplementation, but clear() does not touch the labels. Instead, every route has a time stamp,
+// and the labels of a route are only reset once the route is updated for the first time after clear(). Thus, the
+// reset cost depends on the number of routes touched by the query, and not on the size of the network.
+template<typename LABEL>
+class ReachedIndexTimestampImplementation {
+
+public:
+    using Label = LABEL;
+    using Type = ReachedIndexTimestampImplementation<Label>;
+
+public:
+    ReachedIndexTimestampImplementation(const Data& data) :
+        data(data),
+        labels(data.numberOfTrips(), -1),
+        defaultLabels(data.numberOfRoutes(), -1),
+        timeStamps(data.numberOfRoutes(), 0),
+        timeStamp(0) {
+        for (const TripId trip : data.trips()) {
+            if (data.numberOfStopsInTrip(trip) > std::numeric_limits<Label>::max()) warning("Trip ", trip, " has ", data.numberOfStopsInTrip(trip), " stops!");
+            labels[trip] = data.numberOfStopsInTrip(trip);
+        }
+        for (const RouteId route : data.raptorData.routes()) {
+            defaultLabels[route] = data.numberOfStopsInRoute(route);
+        }
+    }
+
+public:
+    inline void clear() noexcept {
+        timeStamp++;
+        if (timeStamp == 0) {
+            for (const RouteId route : data.raptorData.routes()) {
+                resetRoute(route);
+            }
+        }
+    }
+
+    inline StopIndex operator()(const TripId trip) const noexcept {
+        AssertMsg(trip < labels.size(), "Trip " << trip << " is out of bounds!");
+        return StopIndex(getLabel(trip));
+    }
+
+    inline bool alreadyReached(const TripId trip, const Label index) const noexcept {
+        return getLabel(trip) <= index;
+    }
+
+    inline void update(const TripId trip, const StopIndex index) noexcept {
+        AssertMsg(trip < labels.size(), "Trip " << trip << " is out of bounds!");
+        const RouteId route = data.routeOfTrip[trip];
+        if (timeStamps[route] != timeStamp) resetRoute(route);
+        ReachedIndexImplementation<Label>::updateLabels(labels.data(), trip, data.firstTripOfRoute[route + 1], index);
+    }
+
+private:
+    inline Label getLabel(const TripId trip) const noexcept {
+        const RouteId route = data.routeOfTrip[trip];
+        return (timeStamps[route] == timeStamp) ? labels[trip] : defaultLabels[route];
+    }
+
+    inline void resetRoute(const RouteId route) noexcept {
+        std::fill(labels.begin() + data.firstTripOfRoute[route], labels.begin() + data.firstTripOfRoute[route + 1], defaultLabels[route]);
+        timeStamps[route] = timeStamp;
+    }
+
+private:
+    const Data& data;
+
+    std::vector<Label> labels;
+
+    std::vector<Label> defaultLabels;
+
+    std::vector<u_int32_t> timeStamps;
+    u_int32_t timeStamp;
+
+};
+
+using ReachedIndexTimestampSmall = ReachedIndexTimestampImplementation<u_int8_t>;
+using ReachedIndexTimestampMedium = ReachedIndexTimestampImplementation<u_int16_t>;
+using ReachedIndexTimestampLarge = ReachedIndexTimestampImplementation<u_int32_t>;
+
+}
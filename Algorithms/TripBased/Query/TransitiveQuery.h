@@ -20,12 +20,15 @@
 
 #pragma once
 
-#include "ReachedIndexSmall.h"
+#include "ReachedIndex.h"
+#include "ReachedIndexTimestamp.h"
 #include "Query.h"
 
 #include "../../../DataStructures/TripBased/Data.h"
 #include "../../../DataStructures/Container/Set.h"
 
+#include "../../../Helpers/AllocationCounter.h"
+
 namespace TripBased {
 
 template<typename REACHED_INDEX, bool DEBUG = false>
@@ -46,28 +49,6 @@ private:
         u_int32_t end;
     };
 
-    struct EdgeLabel {
-        EdgeLabel(const StopEventId stopEvent = noStopEvent, const TripId trip = noTripId, const StopEventId firstEvent = noStopEvent) :
-            stopEvent(stopEvent),
-            trip(trip),
-            firstEvent(firstEvent) {
-        }
-        StopEventId stopEvent;
-        TripId trip;
-        StopEventId firstEvent;
-    };
-
-    struct RouteLabel {
-        RouteLabel() :
-            numberOfTrips(0) {
-        }
-        inline StopIndex end() const noexcept {
-            return StopIndex(departureTimes.size() / numberOfTrips);
-        }
-        u_int32_t numberOfTrips;
-        std::vector<int> departureTimes;
-    };
-
 public:
     TransitiveQuery(const Data& data) :
         data(data),
@@ -78,35 +59,25 @@ public:
         lastTarget(Vertex(0)),
         reachedRoutes(data.numberOfRoutes()),
         reachedIndex(data),
-        edgeLabels(data.stopEventGraph.numEdges()),
-        routeLabels(data.numberOfRoutes()) {
+        edgeLabels(data.edgeLabels),
+        routeLabels(data.routeLabels) {
         reverseTransferGraph.revert();
-        for (const Edge edge : data.stopEventGraph.edges()) {
-            edgeLabels[edge].stopEvent = StopEventId(data.stopEventGraph.get(ToVertex, edge) + 1);
-            edgeLabels[edge].trip = data.tripOfStopEvent[data.stopEventGraph.get(ToVertex, edge)];
-            edgeLabels[edge].firstEvent = data.firstStopEventOfTrip[edgeLabels[edge].trip];
-        }
-        for (const RouteId route : data.raptorData.routes()) {
-            const size_t numberOfStops = data.numberOfStopsInRoute(route);
-            const size_t numberOfTrips = data.raptorData.numberOfTripsInRoute(route);
-            const RAPTOR::StopEvent* stopEvents = data.raptorData.firstTripOfRoute(route);
-            routeLabels[route].numberOfTrips = numberOfTrips;
-            routeLabels[route].departureTimes.resize((numberOfStops - 1) * numberOfTrips);
-            for (size_t trip = 0; trip < numberOfTrips; trip++) {
-                for (size_t stopIndex = 0; stopIndex + 1 < numberOfStops; stopIndex++) {
-                    routeLabels[route].departureTimes[(stopIndex * numberOfTrips) + trip] = stopEvents[(trip * numberOfStops) + stopIndex].departureTime;
-                }
-            }
-        }
+        AssertMsg(data.hasQueryLabels(), "The query labels of the Trip-Based data are missing!");
     }
 
     inline void run(const Vertex source, const int departureTime, const Vertex target) noexcept {
+        const size_t allocationsAtStart = Debug ? AllocationCounter::count() : 0;
         if (Debug) totalTimer.restart();
         clear();
         computeInitialAndFinalTransfers(source, departureTime, target);
         evaluateInitialTransfers(source, departureTime);
         scanTrips();
-        if (Debug) totalTime += totalTimer.elapsedMicroseconds();
+        if (Debug) {
+            totalTime += totalTimer.elapsedMicroseconds();
+            const size_t allocations = AllocationCounter::count() - allocationsAtStart;
+            allocationCount += allocations;
+            if (allocations > 0) allocatingQueryCount++;
+        }
     }
 
     inline int getEarliestArrivalTime() const noexcept {
@@ -142,6 +113,10 @@ public:
         std::cout << "Bucket-CH query time: " << String::musToString(chTime / f) << std::endl;
         std::cout << "Initial transfer evaluation time: " << String::musToString(initialTime / f) << std::endl;
         std::cout << "Trip scanning time: " << String::musToString(scanTime / f) << std::endl;
+        if constexpr (AllocationCounter::Enabled) {
+            std::cout << "Number of heap allocations: " << String::prettyDouble(allocationCount / f, 2) << std::endl;
+            std::cout << "Queries with heap allocations: " << String::prettyInt(allocatingQueryCount) << std::endl;
+        }
         std::cout << "total time: " << String::musToString(totalTime / f) << std::endl;
         addJourneyCount = 0;
         enqueueCount = 0;
@@ -150,6 +125,8 @@ public:
         scannedShortcutCount = 0;
         roundCount = 0;
         initialTransferCount = 0;
+        allocationCount = 0;
+        allocatingQueryCount = 0;
         chTime = 0.0;
         initialTime = 0.0;
         scanTime = 0.0;
@@ -163,7 +140,7 @@ private:
         reachedIndex.clear();
         numberOfUsedVehicles = 0;
         minArrivalTime = INFTY;
-        std::vector<int>(1, INFTY).swap(minArrivalTimeByMaxNumberOfUsedVehicles);
+        minArrivalTimeByMaxNumberOfUsedVehicles.assign(1, INFTY);
     }
 
     inline void computeInitialAndFinalTransfers(const Vertex source, const int departureTime, const Vertex target) noexcept {
@@ -207,6 +184,7 @@ private:
         reachedRoutes.sort();
         for (const RouteId route : reachedRoutes) {
             const RouteLabel& label = routeLabels[route];
+            const int* departureTimes = data.departureTimesOfRoute(route);
             const StopIndex endIndex = label.end();
             const TripId firstTrip = data.firstTripOfRoute[route];
             const StopId* stops = data.raptorData.stopArrayOfRoute(route);
@@ -217,14 +195,14 @@ private:
                 const u_int32_t labelIndex = stopIndex * label.numberOfTrips;
                 if (tripIndex >= label.numberOfTrips) {
                     tripIndex = std::lower_bound(TripId(0), TripId(label.numberOfTrips), departureTime + timeFromSource, [&](const TripId trip, const int time) {
-                        return label.departureTimes[labelIndex + trip] < time;
+                        return departureTimes[labelIndex + trip] < time;
                     });
                     if (tripIndex >= label.numberOfTrips) continue;
                 } else {
                     const int stopDepartureTime = departureTime + timeFromSource;
-                    if (label.departureTimes[labelIndex + tripIndex - 1] < stopDepartureTime) continue;
+                    if (departureTimes[labelIndex + tripIndex - 1] < stopDepartureTime) continue;
                     tripIndex--;
-                    while ((tripIndex > 0) && (label.departureTimes[labelIndex + tripIndex - 1] >= stopDepartureTime)) {
+                    while ((tripIndex > 0) && (departureTimes[labelIndex + tripIndex - 1] >= stopDepartureTime)) {
                         tripIndex--;
                     }
                 }
@@ -313,8 +291,8 @@ private:
     u_int32_t numberOfUsedVehicles;
     std::vector<int> minArrivalTimeByMaxNumberOfUsedVehicles;
 
-    std::vector<EdgeLabel> edgeLabels;
-    std::vector<RouteLabel> routeLabels;
+    const MappedVector<EdgeLabel>& edgeLabels;
+    const std::vector<RouteLabel>& routeLabels;
 
     size_t addJourneyCount{0};
     size_t enqueueCount{0};
@@ -323,6 +301,8 @@ private:
     size_t scannedShortcutCount{0};
     size_t roundCount{0};
     size_t initialTransferCount{0};
+    size_t allocationCount{0};
+    size_t allocatingQueryCount{0};
     Timer chTimer;
     Timer initialTimer;
     Timer scanTimer;
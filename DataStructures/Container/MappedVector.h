@@ -0,0 +1,207 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../../Helpers/Assert.h"
+#include "../../Helpers/FileSystem/FileSystem.h"
+#include "../../Helpers/IO/MemoryMappedFile.h"
+#include "../../Helpers/IO/Serialization.h"
+
+// A read-mostly array, which either owns its elements (like an std::vector) or views the contents of a
+// memory mapped file. The mapped file contains the raw elements without any header, such that the array
+// starts at a page boundary. Operations that change the size turn a mapped array into an owning one.
+template<typename T>
+class MappedVector {
+    static_assert(std::is_trivially_copyable_v<T>, "MappedVector requires trivially copyable elements!");
+
+public:
+    using ValueType = T;
+    using Type = MappedVector<ValueType>;
+    using value_type = ValueType;
+    using Iterator = ValueType*;
+    using ConstIterator = const ValueType*;
+
+public:
+    MappedVector() :
+        pointer(nullptr),
+        length(0) {
+    }
+
+    MappedVector(const std::vector<ValueType>& vector) :
+        vector(vector) {
+        update();
+    }
+
+    MappedVector(std::vector<ValueType>&& vector) :
+        vector(std::move(vector)) {
+        update();
+    }
+
+    MappedVector(const MappedVector& other) :
+        vector(other.begin(), other.end()) {
+        update();
+    }
+
+    MappedVector(MappedVector&& other) :
+        vector(std::move(other.vector)),
+        file(std::move(other.file)),
+        pointer(std::exchange(other.pointer, nullptr)),
+        length(std::exchange(other.length, 0)) {
+    }
+
+    MappedVector& operator=(const MappedVector& other) noexcept {
+        if (this != &other) {
+            file.close();
+            vector.assign(other.begin(), other.end());
+            update();
+        }
+        return *this;
+    }
+
+    MappedVector& operator=(MappedVector&& other) noexcept {
+        if (this != &other) {
+            vector = std::move(other.vector);
+            file = std::move(other.file);
+            pointer = std::exchange(other.pointer, nullptr);
+            length = std::exchange(other.length, 0);
+        }
+        return *this;
+    }
+
+public:
+    inline size_t size() const noexcept {return length;}
+    inline bool empty() const noexcept {return length == 0;}
+    inline bool isMapped() const noexcept {return file.isOpen();}
+
+    inline ValueType& operator[](const size_t i) noexcept {
+        AssertMsg(i < length, "Index " << i << " is out of range!");
+        return pointer[i];
+    }
+
+    inline const ValueType& operator[](const size_t i) const noexcept {
+        AssertMsg(i < length, "Index " << i << " is out of range!");
+        return pointer[i];
+    }
+
+    inline ValueType& front() noexcept {return pointer[0];}
+    inline const ValueType& front() const noexcept {return pointer[0];}
+    inline ValueType& back() noexcept {return pointer[length - 1];}
+    inline const ValueType& back() const noexcept {return pointer[length - 1];}
+
+    inline ValueType* data() noexcept {return pointer;}
+    inline const ValueType* data() const noexcept {return pointer;}
+
+    inline Iterator begin() noexcept {return pointer;}
+    inline ConstIterator begin() const noexcept {return pointer;}
+    inline Iterator end() noexcept {return pointer + length;}
+    inline ConstIterator end() const noexcept {return pointer + length;}
+
+    template<typename... ARGUMENTS>
+    inline ValueType& emplace_back(ARGUMENTS&&... arguments) noexcept {
+        unmap();
+        vector.emplace_back(std::forward<ARGUMENTS>(arguments)...);
+        update();
+        return back();
+    }
+
+    inline void push_back(const ValueType& value) noexcept {
+        emplace_back(value);
+    }
+
+    inline void resize(const size_t newSize, const ValueType& value = ValueType()) noexcept {
+        unmap();
+        vector.resize(newSize, value);
+        update();
+    }
+
+    inline void reserve(const size_t capacity) noexcept {
+        unmap();
+        vector.reserve(capacity);
+        update();
+    }
+
+    inline void clear() noexcept {
+        file.close();
+        vector.clear();
+        update();
+    }
+
+    // Replaces the contents with a view of the given file, which has to be written by writeMappable().
+    inline void map(const std::string& fileName) noexcept {
+        std::vector<ValueType>().swap(vector);
+        file.open(fileName);
+        Ensure(file.numberOfBytes() % sizeof(ValueType) == 0, "The size of " << fileName << " is not a multiple of the element size!");
+        pointer = reinterpret_cast<ValueType*>(file.data());
+        length = file.numberOfBytes() / sizeof(ValueType);
+    }
+
+    inline void writeMappable(const std::string& fileName) const noexcept {
+        std::ofstream os(FileSystem::ensureDirectoryExists(fileName), std::ios::binary);
+        Ensure(os.is_open(), "cannot open file: " << fileName);
+        os.write(reinterpret_cast<const char*>(pointer), length * sizeof(ValueType));
+    }
+
+    // Uses the same format as an std::vector, such that both are interchangeable in binary files.
+    inline void serialize(IO::Serialization& serialize) const noexcept {
+        if (isMapped()) {
+            serialize(std::vector<ValueType>(begin(), end()));
+        } else {
+            serialize(vector);
+        }
+    }
+
+    inline void deserialize(IO::Deserialization& deserialize) noexcept {
+        file.close();
+        deserialize(vector);
+        update();
+    }
+
+    inline long long byteSize() const noexcept {
+        return isMapped() ? 0 : (sizeof(ValueType) * vector.capacity());
+    }
+
+private:
+    inline void unmap() noexcept {
+        if (!isMapped()) return;
+        vector.assign(begin(), end());
+        file.close();
+        update();
+    }
+
+    inline void update() noexcept {
+        pointer = vector.data();
+        length = vector.size();
+    }
+
+private:
+    std::vector<ValueType> vector;
+    IO::MemoryMappedFile file;
+
+    ValueType* pointer;
+    size_t length;
+
+};
@@ -222,6 +222,18 @@ public:
         vertexAttributes.resize(vertexAttributes.size() + n, record);
     }
 
+    // Replaces the adjacency structure by the given edge offsets. All attributes are reset to their default values,
+    // the edge attributes (including ToVertex) have to be filled in by the caller afterwards.
+    inline void setAdjacencyStructure(std::vector<Edge>&& newBeginOut) noexcept {
+        AssertMsg(!newBeginOut.empty(), "Adjacency structure is empty!");
+        beginOut = std::move(newBeginOut);
+        vertexAttributes.clear();
+        vertexAttributes.resize(beginOut.size() - 1);
+        edgeAttributes.clear();
+        edgeAttributes.resize(beginOut.back());
+        checkVectorSize();
+    }
+
     inline EdgeHandle addEdge(const Vertex from, const Vertex to) noexcept {
         AssertMsg(from == numVertices() - 1, "Can only add outgoing edges to last vertex!");
         AssertMsg(isVertex(to), to << " is not a valid vertex!");
@@ -35,6 +35,7 @@
 
 #include "../Intermediate/Data.h"
 #include "../Container/Map.h"
+#include "../Container/MappedVector.h"
 #include "../Container/Set.h"
 #include "../Graph/Graph.h"
 #include "../Geometry/Rectangle.h"
@@ -175,14 +176,14 @@ public:
         return firstStopIdOfRoute[route] + stopIndex;
     }
 
-    inline SubRange<std::vector<RouteSegment>> routesContainingStop(const StopId stop) const noexcept {
+    inline SubRange<MappedVector<RouteSegment>> routesContainingStop(const StopId stop) const noexcept {
         AssertMsg(isStop(stop), "The id " << stop << " does not represent a stop!");
-        return SubRange<std::vector<RouteSegment>>(routeSegments, firstRouteSegmentOfStop, stop);
+        return SubRange<MappedVector<RouteSegment>>(routeSegments, firstRouteSegmentOfStop, stop);
     }
 
-    inline SubRange<std::vector<StopEvent>> stopEventsOfRoute(const RouteId route) const noexcept {
+    inline SubRange<MappedVector<StopEvent>> stopEventsOfRoute(const RouteId route) const noexcept {
         AssertMsg(isRoute(route), "The id " << route << " does not represent a route!");
-        return SubRange<std::vector<StopEvent>>(stopEvents, firstStopEventOfRoute, route);
+        return SubRange<MappedVector<StopEvent>>(stopEvents, firstStopEventOfRoute, route);
     }
 
     inline SubRange<std::vector<StopId>> stopsOfRoute(const RouteId route) const noexcept {
@@ -732,8 +733,23 @@ public:
         transferGraph.writeBinary(fileName + ".graph");
     }
 
+    // Stores the route segments and stop events in separate files, which are memory mapped by deserialize().
+    inline void serializeMappable(const std::string& fileName) const noexcept {
+        IO::serialize(fileName, firstRouteSegmentOfStop, firstStopIdOfRoute, firstStopEventOfRoute, MappedVector<RouteSegment>(), stopIds, MappedVector<StopEvent>(), stopData, routeData, implicitDepartureBufferTimes, implicitArrivalBufferTimes);
+        routeSegments.writeMappable(fileName + ".routeSegments");
+        stopEvents.writeMappable(fileName + ".stopEvents");
+        transferGraph.writeBinary(fileName + ".graph");
+    }
+
     inline void deserialize(const std::string& fileName) noexcept {
         IO::deserialize(fileName, firstRouteSegmentOfStop, firstStopIdOfRoute, firstStopEventOfRoute, routeSegments, stopIds, stopEvents, stopData, routeData, implicitDepartureBufferTimes, implicitArrivalBufferTimes);
+        // Empty arrays in the main file are placeholders for the arrays stored by serializeMappable()
+        const size_t numberOfRouteSegments = firstRouteSegmentOfStop.empty() ? 0 : firstRouteSegmentOfStop.back();
+        const size_t numberOfStopEvents = firstStopEventOfRoute.empty() ? 0 : firstStopEventOfRoute.back();
+        if (routeSegments.empty() && numberOfRouteSegments > 0) routeSegments.map(fileName + ".routeSegments");
+        if (stopEvents.empty() && numberOfStopEvents > 0) stopEvents.map(fileName + ".stopEvents");
+        Ensure(routeSegments.size() == numberOfRouteSegments, "The route segments in " << fileName << " do not match the stops!");
+        Ensure(stopEvents.size() == numberOfStopEvents, "The stop events in " << fileName << " do not match the routes!");
         transferGraph.readBinary(fileName + ".graph");
     }
 
@@ -743,10 +759,10 @@ public:
     std::vector<size_t> firstStopIdOfRoute;
     std::vector<size_t> firstStopEventOfRoute;
 
-    std::vector<RouteSegment> routeSegments;
+    MappedVector<RouteSegment> routeSegments;
 
     std::vector<StopId> stopIds;
-    std::vector<StopEvent> stopEvents;
+    MappedVector<StopEvent> stopEvents;
 
     std::vector<Stop> stopData;
     std::vector<Route> routeData;
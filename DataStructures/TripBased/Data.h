@@ -21,6 +21,8 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
+#include <utility>
 #include <vector>
 
 #include "../RAPTOR/Data.h"
@@ -36,6 +38,35 @@ struct ArrivalEvent {
     StopId stop;
 };
 
+// The target of a stop event graph edge as needed by the queries: the stop event after the transfer target,
+// at which scanning the trip starts, as well as the trip and its first stop event.
+struct EdgeLabel {
+    EdgeLabel(const StopEventId stopEvent = noStopEvent, const TripId trip = noTripId, const StopEventId firstEvent = noStopEvent) :
+        stopEvent(stopEvent),
+        trip(trip),
+        firstEvent(firstEvent) {
+    }
+    StopEventId stopEvent;
+    TripId trip;
+    StopEventId firstEvent;
+};
+
+// The departure times of the trips of a route are stored stop by stop (i.e., transposed compared to the stop
+// events), starting at firstDepartureTime in Data::routeDepartureTimes.
+struct RouteLabel {
+    RouteLabel(const u_int32_t numberOfTrips = 0, const u_int32_t numberOfStops = 0, const size_t firstDepartureTime = 0) :
+        numberOfTrips(numberOfTrips),
+        numberOfStops(numberOfStops),
+        firstDepartureTime(firstDepartureTime) {
+    }
+    inline StopIndex end() const noexcept {
+        return StopIndex(numberOfStops - 1);
+    }
+    u_int32_t numberOfTrips;
+    u_int32_t numberOfStops;
+    size_t firstDepartureTime;
+};
+
 class Data {
 
 public:
@@ -177,6 +208,40 @@ public:
         return trip;
     }
 
+    // Maps a stop event to the corresponding stop event of the network returned by reverseNetwork().
+    inline StopEventId getReverseStopEvent(const StopEventId stopEvent) const noexcept {
+        const RouteId route = routeOfTrip[tripOfStopEvent[stopEvent]];
+        return StopEventId(raptorData.firstStopEventOfRoute[route] + raptorData.firstStopEventOfRoute[route + 1] - 1 - stopEvent);
+    }
+
+    // Returns the network with negated times as given by RAPTOR::Data::reverseNetwork(), including the reversed
+    // stop event graph: the transfer from stop event u to stop event v becomes a transfer from the reverse of v to
+    // the reverse of u. Earliest arrival queries on the reversed network are latest departure queries on this one.
+    inline Data reverseNetwork() const noexcept {
+        Data result(raptorData.reverseNetwork());
+        std::vector<Edge> beginOut(numberOfStopEvents() + 1, Edge(0));
+        for (const Edge edge : stopEventGraph.edges()) {
+            beginOut[getReverseStopEvent(StopEventId(stopEventGraph.get(ToVertex, edge))) + 1]++;
+        }
+        for (size_t i = 1; i < beginOut.size(); i++) {
+            beginOut[i] += beginOut[i - 1];
+        }
+        std::vector<Edge> nextEdge(beginOut.begin(), beginOut.end() - 1);
+        result.stopEventGraph.setAdjacencyStructure(std::move(beginOut));
+        std::vector<Vertex>& toVertex = result.stopEventGraph.get(ToVertex);
+        for (const Vertex from : stopEventGraph.vertices()) {
+            const Vertex reverseFrom = Vertex(getReverseStopEvent(StopEventId(from)));
+            for (const Edge edge : stopEventGraph.edgesFrom(from)) {
+                toVertex[nextEdge[getReverseStopEvent(StopEventId(stopEventGraph.get(ToVertex, edge)))]++] = reverseFrom;
+            }
+        }
+        for (const Vertex from : result.stopEventGraph.vertices()) {
+            std::sort(toVertex.begin() + result.stopEventGraph.beginEdgeFrom(from), toVertex.begin() + result.stopEventGraph.endEdgeFrom(from));
+        }
+        result.computeQueryLabels();
+        return result;
+    }
+
 public:
     inline void printInfo() const noexcept {
         int firstDay = std::numeric_limits<int>::max();
@@ -199,16 +264,157 @@ public:
         std::cout << "   Bounding Box:             " << std::setw(12) << raptorData.boundingBox() << std::endl;
     }
 
+    // The query labels are derived from the stop event graph and the timetable. They have to be recomputed
+    // after the stop event graph has changed, before the data is serialized. Arc flags refer to the edges of the
+    // stop event graph as well, so they are discarded.
+    inline void computeQueryLabels() noexcept {
+        clearArcFlags();
+        std::vector<EdgeLabel> newEdgeLabels(stopEventGraph.numEdges());
+        for (const Edge edge : stopEventGraph.edges()) {
+            const StopEventId target(stopEventGraph.get(ToVertex, edge));
+            newEdgeLabels[edge] = EdgeLabel(StopEventId(target + 1), tripOfStopEvent[target], firstStopEventOfTrip[tripOfStopEvent[target]]);
+        }
+        edgeLabels = MappedVector<EdgeLabel>(std::move(newEdgeLabels));
+        routeLabels.clear();
+        std::vector<int> newDepartureTimes;
+        for (const RouteId route : routes()) {
+            const size_t numberOfStops = numberOfStopsInRoute(route);
+            const size_t numberOfTrips = raptorData.numberOfTripsInRoute(route);
+            const RAPTOR::StopEvent* stopEvents = std::as_const(raptorData).firstTripOfRoute(route);
+            routeLabels.emplace_back(numberOfTrips, numberOfStops, newDepartureTimes.size());
+            newDepartureTimes.resize(newDepartureTimes.size() + ((numberOfStops - 1) * numberOfTrips));
+            int* departureTimes = newDepartureTimes.data() + routeLabels.back().firstDepartureTime;
+            for (size_t trip = 0; trip < numberOfTrips; trip++) {
+                for (size_t stopIndex = 0; stopIndex + 1 < numberOfStops; stopIndex++) {
+                    departureTimes[(stopIndex * numberOfTrips) + trip] = stopEvents[(trip * numberOfStops) + stopIndex].departureTime;
+                }
+            }
+        }
+        routeDepartureTimes = MappedVector<int>(std::move(newDepartureTimes));
+    }
+
+    inline bool hasQueryLabels() const noexcept {
+        return (edgeLabels.size() == stopEventGraph.numEdges()) && (routeLabels.size() == numberOfRoutes());
+    }
+
+    inline bool hasArcFlags() const noexcept {
+        if ((arcFlagBytes != 1) && (arcFlagBytes != 2) && (arcFlagBytes != 4) && (arcFlagBytes != 8)) return false;
+        if ((arcFlags.size() != stopEventGraph.numEdges() * arcFlagBytes) || (cellOfStop.size() != numberOfStops())) return false;
+        return std::all_of(cellOfStop.begin(), cellOfStop.end(), [&](const u_int8_t cell) { return cell < arcFlagBytes * 8; });
+    }
+
+    // Stores the flags with the smallest number of bytes per edge that can hold a bit for each cell.
+    inline void setArcFlags(const size_t numberOfCells, const std::vector<u_int64_t>& flags) noexcept {
+        AssertMsg(numberOfCells >= 1 && numberOfCells <= 64, "The number of cells must be between 1 and 64!");
+        AssertMsg(flags.size() == stopEventGraph.numEdges(), "There are " << flags.size() << " flags for " << stopEventGraph.numEdges() << " edges!");
+        arcFlagBytes = (numberOfCells <= 8) ? 1 : (numberOfCells <= 16) ? 2 : (numberOfCells <= 32) ? 4 : 8;
+        arcFlags.assign(flags.size() * arcFlagBytes, 0);
+        for (size_t edge = 0; edge < flags.size(); edge++) {
+            switch (arcFlagBytes) {
+                case 1: storeArcFlags<u_int8_t>(edge, flags[edge]); break;
+                case 2: storeArcFlags<u_int16_t>(edge, flags[edge]); break;
+                case 4: storeArcFlags<u_int32_t>(edge, flags[edge]); break;
+                default: storeArcFlags<u_int64_t>(edge, flags[edge]); break;
+            }
+        }
+    }
+
+    // The number of bytes per edge is the same for all edges, so the branch is predicted correctly during a query.
+    inline u_int64_t getArcFlags(const Edge edge) const noexcept {
+        switch (arcFlagBytes) {
+            case 1: return loadArcFlags<u_int8_t>(edge);
+            case 2: return loadArcFlags<u_int16_t>(edge);
+            case 4: return loadArcFlags<u_int32_t>(edge);
+            default: return loadArcFlags<u_int64_t>(edge);
+        }
+    }
+
+    inline void clearArcFlags() noexcept {
+        cellOfStop.clear();
+        arcFlags.clear();
+        arcFlagBytes = 0;
+    }
+
+    inline const int* departureTimesOfRoute(const RouteId route) const noexcept {
+        AssertMsg(isRoute(route), "The id " << route << " does not represent a route!");
+        return routeDepartureTimes.data() + routeLabels[route].firstDepartureTime;
+    }
+
     inline void serialize(const std::string& fileName) const noexcept {
         raptorData.serialize(fileName + ".raptor");
         IO::serialize(fileName, firstTripOfRoute, routeOfTrip, firstStopIdOfTrip, firstStopEventOfTrip, tripOfStopEvent, indexOfStopEvent, arrivalEvents);
         stopEventGraph.writeBinary(fileName + ".graph");
+        if (hasQueryLabels()) IO::serialize(fileName + ".labels", edgeLabels, routeLabels, routeDepartureTimes);
+        serializeArcFlags(fileName + ".arcFlags");
+    }
+
+    // Stores the large arrays in separate files, which are memory mapped by deserialize().
+    inline void serializeMappable(const std::string& fileName) const noexcept {
+        raptorData.serializeMappable(fileName + ".raptor");
+        IO::serialize(fileName, firstTripOfRoute, routeOfTrip, firstStopIdOfTrip, firstStopEventOfTrip, tripOfStopEvent, indexOfStopEvent, MappedVector<ArrivalEvent>());
+        arrivalEvents.writeMappable(fileName + ".arrivalEvents");
+        stopEventGraph.writeBinary(fileName + ".graph");
+        if (hasQueryLabels()) {
+            IO::serialize(fileName + ".labels", MappedVector<EdgeLabel>(), routeLabels, MappedVector<int>());
+            edgeLabels.writeMappable(fileName + ".edgeLabels");
+            routeDepartureTimes.writeMappable(fileName + ".routeDepartureTimes");
+        }
+        serializeArcFlags(fileName + ".arcFlags");
     }
 
     inline void deserialize(const std::string& fileName) noexcept {
         raptorData.deserialize(fileName + ".raptor");
         IO::deserialize(fileName, firstTripOfRoute, routeOfTrip, firstStopIdOfTrip, firstStopEventOfTrip, tripOfStopEvent, indexOfStopEvent, arrivalEvents);
+        // Empty arrays in the main files are placeholders for the arrays stored by serializeMappable()
+        if (arrivalEvents.empty() && !tripOfStopEvent.empty()) arrivalEvents.map(fileName + ".arrivalEvents");
+        Ensure(arrivalEvents.size() == tripOfStopEvent.size(), "The arrival events in " << fileName << " do not match the stop events!");
         stopEventGraph.readBinary(fileName + ".graph");
+        if (FileSystem::isFile(fileName + ".labels")) {
+            IO::deserialize(fileName + ".labels", edgeLabels, routeLabels, routeDepartureTimes);
+            if (edgeLabels.empty() && stopEventGraph.numEdges() > 0) edgeLabels.map(fileName + ".edgeLabels");
+            if (routeDepartureTimes.empty() && !tripOfStopEvent.empty()) routeDepartureTimes.map(fileName + ".routeDepartureTimes");
+        }
+        if (!hasQueryLabels()) computeQueryLabels();
+        if (FileSystem::isFile(fileName + ".arcFlags")) deserializeArcFlags(fileName + ".arcFlags");
+    }
+
+private:
+    // The arc flags are stored together with the number of edges of the stop event graph they were computed for. An
+    // existing file is removed if there are no arc flags, such that the flags of a previous graph are not loaded.
+    // The format string distinguishes the files from those with 64 bits per edge written by earlier versions.
+    inline static const std::string ArcFlagFormat = "Arc flags with variable size";
+
+    inline void serializeArcFlags(const std::string& fileName) const noexcept {
+        if (hasArcFlags()) {
+            IO::serialize(fileName, stopEventGraph.numEdges(), ArcFlagFormat, cellOfStop, arcFlagBytes, arcFlags);
+        } else {
+            FileSystem::deleteFile(fileName);
+        }
+    }
+
+    inline void deserializeArcFlags(const std::string& fileName) noexcept {
+        size_t numberOfEdges = 0;
+        std::string format;
+        IO::Deserialization deserializer(fileName, numberOfEdges, format);
+        if (format == ArcFlagFormat) {
+            deserializer(cellOfStop, arcFlagBytes, arcFlags);
+            if (numberOfEdges == stopEventGraph.numEdges() && hasArcFlags()) return;
+        }
+        warning("The arc flags in ", fileName, " do not match the stop event graph, they are ignored!");
+        clearArcFlags();
+    }
+
+    template<typename FLAGS>
+    inline void storeArcFlags(const size_t edge, const u_int64_t flags) noexcept {
+        const FLAGS compactFlags = flags;
+        std::memcpy(arcFlags.data() + (edge * sizeof(FLAGS)), &compactFlags, sizeof(FLAGS));
+    }
+
+    template<typename FLAGS>
+    inline u_int64_t loadArcFlags(const size_t edge) const noexcept {
+        FLAGS flags;
+        std::memcpy(&flags, arcFlags.data() + (edge * sizeof(FLAGS)), sizeof(FLAGS));
+        return flags;
     }
 
 public:
@@ -225,7 +431,18 @@ public:
 
     SimpleStaticGraph stopEventGraph;
 
-    std::vector<ArrivalEvent> arrivalEvents;
+    MappedVector<ArrivalEvent> arrivalEvents;
+
+    MappedVector<EdgeLabel> edgeLabels;
+    std::vector<RouteLabel> routeLabels;
+    MappedVector<int> routeDepartureTimes;
+
+    // Optional arc flags for target pruning: the stops are partitioned into at most 64 cells, and bit c of the flags of
+    // an edge is set if the edge is part of an optimal journey to a stop in cell c. Every edge uses arcFlagBytes bytes
+    // of arcFlags (see setArcFlags() and getArcFlags()).
+    std::vector<u_int8_t> cellOfStop;
+    size_t arcFlagBytes{0};
+    std::vector<u_int8_t> arcFlags;
 
 };
 
@@ -25,7 +25,7 @@
 namespace TripBased {
 
 struct Shortcut {
-    Shortcut(const StopEventId origin, const StopEventId destination, const int walkingDistance = 0) :
+    Shortcut(const StopEventId origin = noStopEvent, const StopEventId destination = noStopEvent, const int walkingDistance = 0) :
         origin(origin),
         destination(destination),
         walkingDistance(walkingDistance) {
@@ -0,0 +1,44 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+
+// Counts the heap allocations performed by the current thread, which allows the debug
+// builds of the query algorithms to verify that a warmed-up query does not allocate.
+// The allocations are only counted if COUNT_ALLOCATIONS is defined, in which case
+// AllocationCounter.cpp has to be linked, since it replaces the global operator new.
+// Otherwise, count() always returns 0 and operator new is left untouched.
+namespace AllocationCounter {
+
+#ifdef COUNT_ALLOCATIONS
+inline constexpr bool Enabled = true;
+#else
+inline constexpr bool Enabled = false;
+#endif
+
+inline thread_local size_t numberOfAllocations = 0;
+
+inline size_t count() noexcept {
+    return numberOfAllocations;
+}
+
+}
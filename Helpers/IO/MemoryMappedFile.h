@@ -0,0 +1,109 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../Assert.h"
+
+namespace IO {
+
+// Maps a whole file into memory. The mapping is private and copy-on-write, so unmodified pages are backed
+// directly by the page cache (and shared between processes), while writes only affect this process.
+class MemoryMappedFile {
+
+public:
+    MemoryMappedFile() :
+        address(nullptr),
+        size(0) {
+    }
+
+    MemoryMappedFile(const std::string& fileName) :
+        MemoryMappedFile() {
+        open(fileName);
+    }
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    MemoryMappedFile(MemoryMappedFile&& other) :
+        address(std::exchange(other.address, nullptr)),
+        size(std::exchange(other.size, 0)) {
+    }
+
+    MemoryMappedFile& operator=(MemoryMappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            address = std::exchange(other.address, nullptr);
+            size = std::exchange(other.size, 0);
+        }
+        return *this;
+    }
+
+    ~MemoryMappedFile() {
+        close();
+    }
+
+    inline void open(const std::string& fileName) noexcept {
+        close();
+        const int fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+        Ensure(fileDescriptor >= 0, "cannot open file: " << fileName);
+        struct stat fileStatus;
+        Ensure(fstat(fileDescriptor, &fileStatus) == 0, "cannot determine the size of file: " << fileName);
+        size = fileStatus.st_size;
+        if (size > 0) {
+            address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+            Ensure(address != MAP_FAILED, "cannot map file: " << fileName);
+        }
+        ::close(fileDescriptor);
+    }
+
+    inline void close() noexcept {
+        if (address) munmap(address, size);
+        address = nullptr;
+        size = 0;
+    }
+
+    inline bool isOpen() const noexcept {
+        return address != nullptr;
+    }
+
+    inline void* data() const noexcept {
+        return address;
+    }
+
+    inline size_t numberOfBytes() const noexcept {
+        return size;
+    }
+
+private:
+    void* address;
+    size_t size;
+
+};
+
+}
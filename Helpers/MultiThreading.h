@@ -20,11 +20,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <vector>
 #include <thread>
 #include <cmath>
+#include <utility>
 
 #include "Assert.h"
 #include "Helpers.h"
@@ -184,3 +186,37 @@ public:
     size_t pinMultiplier;
 
 };
+
+// Range [begin, end) of the indices 0, ..., size - 1 that is assigned to the calling thread of an omp parallel region.
+inline std::pair<size_t, size_t> getThreadBlock(const size_t size) noexcept {
+    const size_t numberOfThreads = omp_get_num_threads();
+    const size_t blockSize = (size + numberOfThreads - 1) / numberOfThreads;
+    const size_t blockBegin = std::min(size, omp_get_thread_num() * blockSize);
+    return std::make_pair(blockBegin, std::min(size, blockBegin + blockSize));
+}
+
+// In-place inclusive prefix sum, which has to be called by all threads of an omp parallel region.
+// Blocked prefix sum: every thread sums up its block, the block offsets are computed sequentially.
+// The shared vector blockSum holds the block offsets.
+template<typename T>
+inline void parallelPrefixSum(std::vector<T>& values, std::vector<T>& blockSum) noexcept {
+    const size_t threadId = omp_get_thread_num();
+    const auto [blockBegin, blockEnd] = getThreadBlock(values.size());
+    #pragma omp single
+    blockSum.assign(omp_get_num_threads() + 1, T(0));
+    for (size_t i = blockBegin + 1; i < blockEnd; i++) {
+        values[i] += values[i - 1];
+    }
+    if (blockBegin < blockEnd) blockSum[threadId + 1] = values[blockEnd - 1];
+    #pragma omp barrier
+    #pragma omp single
+    {
+        for (size_t i = 1; i < blockSum.size(); i++) {
+            blockSum[i] += blockSum[i - 1];
+        }
+    }
+    for (size_t i = blockBegin; i < blockEnd; i++) {
+        values[i] += blockSum[threadId];
+    }
+    #pragma omp barrier
+}
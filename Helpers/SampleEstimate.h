@@ -0,0 +1,83 @@
+/**********************************************************************************
+
+ Copyright (c) 2021 Jonas Sauer
+
+ MIT License
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+ modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+ is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Extrapolates the total of a value over a population from a uniform random sample without replacement. The
+// confidence interval uses the normal approximation with finite population correction.
+class SampleEstimate {
+
+public:
+    SampleEstimate(const size_t populationSize = 0, const double z = 1.96) :
+        populationSize(populationSize),
+        z(z) {
+    }
+
+    inline void add(const double value) noexcept {
+        values.emplace_back(value);
+    }
+
+    inline size_t sampleSize() const noexcept {
+        return values.size();
+    }
+
+    inline double mean() const noexcept {
+        if (values.empty()) return 0;
+        double sum = 0;
+        for (const double value : values) {
+            sum += value;
+        }
+        return sum / values.size();
+    }
+
+    inline double total() const noexcept {
+        return populationSize * mean();
+    }
+
+    inline double marginOfError() const noexcept {
+        if (values.size() < 2 || populationSize < 2) return 0;
+        const double m = mean();
+        double squaredDeviations = 0;
+        for (const double value : values) {
+            squaredDeviations += (value - m) * (value - m);
+        }
+        const double variance = squaredDeviations / (values.size() - 1);
+        const double correction = double(populationSize - std::min(values.size(), populationSize)) / (populationSize - 1);
+        return z * populationSize * std::sqrt(variance / values.size() * correction);
+    }
+
+    inline double lowerBound() const noexcept {
+        return std::max(0.0, total() - marginOfError());
+    }
+
+    inline double upperBound() const noexcept {
+        return total() + marginOfError();
+    }
+
+private:
+    size_t populationSize;
+    double z;
+    std::vector<double> values;
+
+};
@@ -216,7 +216,10 @@ public:
             size_t index = (*this)[i];
             while (!seen[index]) {
                 seen[index] = true;
-                std::swap(vector[i], vector[index]);
+                // Swap via value_type, since the proxy references of std::vector<bool> cannot bind to std::swap(T&, T&).
+                typename std::vector<T>::value_type temp = std::move(vector[i]);
+                vector[i] = std::move(vector[index]);
+                vector[index] = std::move(temp);
                 index = (*this)[index];
             }
         }
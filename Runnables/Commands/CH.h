@@ -38,10 +38,12 @@
 #include "../../Algorithms/CH/Preprocessing/Profiler.h"
 #include "../../Algorithms/CH/Preprocessing/StopCriterion.h"
 #include "../../Algorithms/CH/Preprocessing/WitnessSearch.h"
+#include "../../Algorithms/CH/Query/BucketGraph.h"
 #include "../../Algorithms/CH/Query/CHQuery.h"
 #include "../../Algorithms/CH/CH.h"
 
 #include "../../Helpers/IO/Serialization.h"
+#include "../../Helpers/MultiThreading.h"
 #include "../../Helpers/String/String.h"
 #include "../../Helpers/Vector/Permutation.h"
 #include "../../Helpers/Timer.h"
@@ -251,3 +253,30 @@ private:
     size_t numberOfStops;
 
 };
+
+class BuildBucketGraph : public ParameterizedCommand {
+
+public:
+    BuildBucketGraph(BasicShell& shell) :
+        ParameterizedCommand(shell, "buildBucketGraph", "Computes the Bucket-CH bucket graphs for the first vertices of a CH and stores them next to the CH files.") {
+        addParameter("CH file");
+        addParameter("Number of POIs");
+        addParameter("Number of threads", "max");
+        addParameter("Pin multiplier", "1");
+    }
+
+    virtual void execute() noexcept {
+        const std::string chFile = getParameter("CH file");
+        const size_t numberOfPOIs = getParameter<size_t>("Number of POIs");
+        const size_t numberOfThreads = (getParameter("Number of threads") == "max") ? numberOfCores() : getParameter<size_t>("Number of threads");
+        const size_t pinMultiplier = getParameter<size_t>("Pin multiplier");
+
+        CH::CH ch(chFile);
+        CH::BucketGraph bucketGraph;
+        bucketGraph.build(ch.forward, ch.backward, ch.forward[Weight], ch.backward[Weight], numberOfPOIs, ThreadPinning(numberOfThreads, pinMultiplier), true);
+        bucketGraph.writeBinary(chFile + ".bucket");
+        Graph::printInfo(bucketGraph.getGraph(FORWARD));
+        Graph::printInfo(bucketGraph.getGraph(BACKWARD));
+    }
+
+};
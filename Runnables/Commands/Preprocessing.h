@@ -20,18 +20,28 @@
 
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <numeric>
+#include <random>
 #include <string>
 
 #include "../../Algorithms/RAPTOR/ULTRA/Builder.h"
+#include "../../Algorithms/TripBased/Preprocessing/ArcFlagBuilder.h"
 #include "../../Algorithms/TripBased/Preprocessing/StopEventGraphBuilder.h"
+#include "../../Algorithms/TripBased/Preprocessing/TimetableDiff.h"
 #include "../../Algorithms/TripBased/Preprocessing/ULTRABuilder.h"
+#include "../../Algorithms/TripBased/Query/ReachedIndex.h"
 
 #include "../../DataStructures/Graph/Graph.h"
 #include "../../DataStructures/RAPTOR/Data.h"
 #include "../../DataStructures/TripBased/Data.h"
 
 #include "../../Helpers/MultiThreading.h"
+#include "../../Helpers/SampleEstimate.h"
+#include "../../Helpers/Timer.h"
+#include "../../Helpers/FileSystem/FileSystem.h"
 
 #include "../../Shell/Shell.h"
 
@@ -49,6 +59,10 @@ public:
         addParameter("Pin multiplier", "1");
         addParameter("Prune with existing shortcuts?", "true");
         addParameter("Require direct transfer?", "false");
+        addParameter("Max departures per job", "0");
+        addParameter("Checkpoint file", "none");
+        addParameter("Checkpoint interval (s)", "600");
+        addParameter("Resume?", "false");
     }
 
     virtual void execute() noexcept {
@@ -59,11 +73,12 @@ public:
         const size_t pinMultiplier = getParameter<size_t>("Pin multiplier");
         const bool pruneWithExistingShortcuts = getParameter<bool>("Prune with existing shortcuts?");
         const bool requireDirectTransfer = getParameter<bool>("Require direct transfer?");
+        const size_t maxDeparturesPerJob = getParameter<size_t>("Max departures per job");
 
         RAPTOR::Data data = RAPTOR::Data::FromBinary(inputFile);
         data.useImplicitDepartureBufferTimes();
         data.printInfo();
-        choosePrune(data, numberOfThreads, pinMultiplier, witnessLimit, requireDirectTransfer, pruneWithExistingShortcuts);
+        choosePrune(data, numberOfThreads, pinMultiplier, witnessLimit, requireDirectTransfer, pruneWithExistingShortcuts, maxDeparturesPerJob);
         data.dontUseImplicitDepartureBufferTimes();
         Graph::printInfo(data.transferGraph);
         data.transferGraph.printAnalysis();
@@ -79,28 +94,43 @@ private:
         }
     }
 
-    inline void choosePrune(RAPTOR::Data& data, const size_t numberOfThreads, const size_t pinMultiplier, const size_t witnessLimit, const bool requireDirectTransfer, const bool pruneWithExistingShortcuts) const noexcept {
+    template<typename BUILDER>
+    inline void setUpCheckpoints(BUILDER& builder) const noexcept {
+        const std::string checkpointFile = getParameter("Checkpoint file");
+        if (checkpointFile == "none") return;
+        if (getParameter<bool>("Resume?")) {
+            if (FileSystem::isFile(checkpointFile)) {
+                builder.resumeFromCheckpoint(checkpointFile);
+            } else {
+                std::cout << "Checkpoint " << checkpointFile << " does not exist, starting from scratch." << std::endl;
+            }
+        }
+        builder.enableCheckpoints(checkpointFile, getParameter<double>("Checkpoint interval (s)"));
+    }
+
+    inline void choosePrune(RAPTOR::Data& data, const size_t numberOfThreads, const size_t pinMultiplier, const size_t witnessLimit, const bool requireDirectTransfer, const bool pruneWithExistingShortcuts, const size_t maxDeparturesPerJob) const noexcept {
         if (pruneWithExistingShortcuts) {
-            chooseRequireDirectTransfer<true>(data, numberOfThreads, pinMultiplier, witnessLimit, requireDirectTransfer);
+            chooseRequireDirectTransfer<true>(data, numberOfThreads, pinMultiplier, witnessLimit, requireDirectTransfer, maxDeparturesPerJob);
         } else {
-            chooseRequireDirectTransfer<false>(data, numberOfThreads, pinMultiplier, witnessLimit, requireDirectTransfer);
+            chooseRequireDirectTransfer<false>(data, numberOfThreads, pinMultiplier, witnessLimit, requireDirectTransfer, maxDeparturesPerJob);
         }
     }
 
     template<bool PRUNE_WITH_EXISTING_SHORTCUTS>
-    inline void chooseRequireDirectTransfer(RAPTOR::Data& data, const size_t numberOfThreads, const size_t pinMultiplier, const size_t witnessLimit, const bool requireDirectTransfer) const noexcept {
+    inline void chooseRequireDirectTransfer(RAPTOR::Data& data, const size_t numberOfThreads, const size_t pinMultiplier, const size_t witnessLimit, const bool requireDirectTransfer, const size_t maxDeparturesPerJob) const noexcept {
         if (requireDirectTransfer) {
-            run<PRUNE_WITH_EXISTING_SHORTCUTS, true>(data, numberOfThreads, pinMultiplier, witnessLimit);
+            run<PRUNE_WITH_EXISTING_SHORTCUTS, true>(data, numberOfThreads, pinMultiplier, witnessLimit, maxDeparturesPerJob);
         } else {
-            run<PRUNE_WITH_EXISTING_SHORTCUTS, false>(data, numberOfThreads, pinMultiplier, witnessLimit);
+            run<PRUNE_WITH_EXISTING_SHORTCUTS, false>(data, numberOfThreads, pinMultiplier, witnessLimit, maxDeparturesPerJob);
         }
     }
 
     template<bool PRUNE_WITH_EXISTING_SHORTCUTS, bool REQUIRE_DIRECT_TRANSFER>
-    inline void run(RAPTOR::Data& data, const size_t numberOfThreads, const size_t pinMultiplier, const size_t witnessLimit) const noexcept {
+    inline void run(RAPTOR::Data& data, const size_t numberOfThreads, const size_t pinMultiplier, const size_t witnessLimit, const size_t maxDeparturesPerJob) const noexcept {
         RAPTOR::ULTRA::Builder<false, PRUNE_WITH_EXISTING_SHORTCUTS, REQUIRE_DIRECT_TRANSFER> shortcutGraphBuilder(data);
+        setUpCheckpoints(shortcutGraphBuilder);
         std::cout << "Computing stop-to-stop ULTRA shortcuts (parallel with " << numberOfThreads << " threads)." << std::endl;
-        shortcutGraphBuilder.computeShortcuts(ThreadPinning(numberOfThreads, pinMultiplier), witnessLimit);
+        shortcutGraphBuilder.computeShortcuts(ThreadPinning(numberOfThreads, pinMultiplier), witnessLimit, -never, never, true, maxDeparturesPerJob);
         Graph::move(std::move(shortcutGraphBuilder.getShortcutGraph()), data.transferGraph);
     }
 };
@@ -114,6 +144,7 @@ public:
         addParameter("Output file");
         addParameter("Number of threads", "max");
         addParameter("Pin multiplier", "1");
+        addParameter("Spill threshold (edges per thread)", "0");
     }
 
     virtual void execute() noexcept {
@@ -121,6 +152,7 @@ public:
         const std::string outputFile = getParameter("Output file");
         const int numberOfThreads = getNumberOfThreads();
         const int pinMultiplier = getParameter<int>("Pin multiplier");
+        const size_t spillThreshold = getParameter<size_t>("Spill threshold (edges per thread)");
 
         RAPTOR::Data raptor = RAPTOR::Data::FromBinary(inputFile);
         raptor.printInfo();
@@ -129,9 +161,10 @@ public:
         if (numberOfThreads == 0) {
             TripBased::ComputeStopEventGraph(data);
         } else {
-            TripBased::ComputeStopEventGraph(data, numberOfThreads, pinMultiplier);
+            TripBased::ComputeStopEventGraph(data, numberOfThreads, pinMultiplier, spillThreshold);
         }
 
+        data.computeQueryLabels();
         data.printInfo();
         data.serialize(outputFile);
     }
@@ -157,6 +190,10 @@ public:
         addParameter("Witness limit");
         addParameter("Number of threads", "max");
         addParameter("Pin multiplier", "1");
+        addParameter("Max departures per job", "0");
+        addParameter("Checkpoint file", "none");
+        addParameter("Checkpoint interval (s)", "600");
+        addParameter("Resume?", "false");
     }
 
     virtual void execute() noexcept {
@@ -165,17 +202,559 @@ public:
         const int witnessLimit = getParameter<int>("Witness limit");
         const int numberOfThreads = getNumberOfThreads();
         const int pinMultiplier = getParameter<int>("Pin multiplier");
+        const size_t maxDeparturesPerJob = getParameter<size_t>("Max departures per job");
 
         RAPTOR::Data raptor = RAPTOR::Data::FromBinary(inputFile);
         raptor.printInfo();
         TripBased::Data data(raptor);
 
         TripBased::ULTRABuilder shortcutGraphBuilder(data);
+        setUpCheckpoints(shortcutGraphBuilder);
         std::cout << "Computing event-to-event ULTRA shortcuts (parallel with " << numberOfThreads << " threads)." << std::endl;
-        shortcutGraphBuilder.computeShortcuts(ThreadPinning(numberOfThreads, pinMultiplier), witnessLimit);
+        shortcutGraphBuilder.computeShortcuts(ThreadPinning(numberOfThreads, pinMultiplier), witnessLimit, -never, never, true, maxDeparturesPerJob);
+        Graph::move(std::move(shortcutGraphBuilder.getStopEventGraph()), data.stopEventGraph);
+
+        data.computeQueryLabels();
+        data.printInfo();
+        data.serialize(outputFile);
+    }
+
+private:
+    inline int getNumberOfThreads() const noexcept {
+        if (getParameter("Number of threads") == "max") {
+            return numberOfCores();
+        } else {
+            return getParameter<int>("Number of threads");
+        }
+    }
+
+    template<typename BUILDER>
+    inline void setUpCheckpoints(BUILDER& builder) const noexcept {
+        const std::string checkpointFile = getParameter("Checkpoint file");
+        if (checkpointFile == "none") return;
+        if (getParameter<bool>("Resume?")) {
+            if (FileSystem::isFile(checkpointFile)) {
+                builder.resumeFromCheckpoint(checkpointFile);
+            } else {
+                std::cout << "Checkpoint " << checkpointFile << " does not exist, starting from scratch." << std::endl;
+            }
+        }
+        builder.enableCheckpoints(checkpointFile, getParameter<double>("Checkpoint interval (s)"));
+    }
+
+};
+
+class ComputeStopToStopShortcutShard : public ParameterizedCommand {
+
+public:
+    ComputeStopToStopShortcutShard(BasicShell& shell) :
+        ParameterizedCommand(shell, "computeStopToStopShortcutShard", "Computes the stop-to-stop ULTRA shortcuts for a departure time range [min, max) and the source stops of one shard (stop id modulo number of shards), and saves them as a partial file.") {
+        addParameter("Input file");
+        addParameter("Partial file");
+        addParameter("Witness limit");
+        addParameter("Minimum departure time", "min");
+        addParameter("Maximum departure time", "max");
+        addParameter("Shard", "0");
+        addParameter("Number of shards", "1");
+        addParameter("Number of threads", "max");
+        addParameter("Pin multiplier", "1");
+        addParameter("Prune with existing shortcuts?", "true");
+        addParameter("Require direct transfer?", "false");
+        addParameter("Max departures per job", "0");
+    }
+
+    virtual void execute() noexcept {
+        const std::string inputFile = getParameter("Input file");
+        const std::string partialFile = getParameter("Partial file");
+        const size_t numberOfThreads = getNumberOfThreads();
+        const size_t pinMultiplier = getParameter<size_t>("Pin multiplier");
+        const bool pruneWithExistingShortcuts = getParameter<bool>("Prune with existing shortcuts?");
+        const bool requireDirectTransfer = getParameter<bool>("Require direct transfer?");
+
+        RAPTOR::Data data = RAPTOR::Data::FromBinary(inputFile);
+        data.useImplicitDepartureBufferTimes();
+        data.printInfo();
+        if (pruneWithExistingShortcuts) {
+            chooseRequireDirectTransfer<true>(data, partialFile, numberOfThreads, pinMultiplier, requireDirectTransfer);
+        } else {
+            chooseRequireDirectTransfer<false>(data, partialFile, numberOfThreads, pinMultiplier, requireDirectTransfer);
+        }
+    }
+
+private:
+    inline size_t getNumberOfThreads() const noexcept {
+        if (getParameter("Number of threads") == "max") {
+            return numberOfCores();
+        } else {
+            return getParameter<int>("Number of threads");
+        }
+    }
+
+    template<bool PRUNE_WITH_EXISTING_SHORTCUTS>
+    inline void chooseRequireDirectTransfer(const RAPTOR::Data& data, const std::string& partialFile, const size_t numberOfThreads, const size_t pinMultiplier, const bool requireDirectTransfer) const noexcept {
+        if (requireDirectTransfer) {
+            run<PRUNE_WITH_EXISTING_SHORTCUTS, true>(data, partialFile, numberOfThreads, pinMultiplier);
+        } else {
+            run<PRUNE_WITH_EXISTING_SHORTCUTS, false>(data, partialFile, numberOfThreads, pinMultiplier);
+        }
+    }
+
+    template<bool PRUNE_WITH_EXISTING_SHORTCUTS, bool REQUIRE_DIRECT_TRANSFER>
+    inline void run(const RAPTOR::Data& data, const std::string& partialFile, const size_t numberOfThreads, const size_t pinMultiplier) const noexcept {
+        const size_t shard = getParameter<size_t>("Shard");
+        const size_t numberOfShards = getParameter<size_t>("Number of shards");
+        Ensure(shard < numberOfShards, "Shard " << shard << " does not exist (number of shards: " << numberOfShards << ")!");
+        RAPTOR::ULTRA::Builder<false, PRUNE_WITH_EXISTING_SHORTCUTS, REQUIRE_DIRECT_TRANSFER> shortcutGraphBuilder(data);
+        std::cout << "Computing stop-to-stop ULTRA shortcuts for shard " << shard << " of " << numberOfShards << " (parallel with " << numberOfThreads << " threads)." << std::endl;
+        shortcutGraphBuilder.computeShortcuts(ThreadPinning(numberOfThreads, pinMultiplier), getParameter<size_t>("Witness limit"), getMinDepartureTime(), getMaxDepartureTime(), true, getParameter<size_t>("Max departures per job"), shard, numberOfShards);
+        Graph::printInfo(shortcutGraphBuilder.getShortcutGraph());
+        shortcutGraphBuilder.writeShortcuts(partialFile);
+    }
+
+    inline int getMinDepartureTime() const noexcept {
+        const std::string time = getParameter("Minimum departure time");
+        return (time == "min") ? -never : String::parseSeconds(time);
+    }
+
+    // The maximum departure time is exclusive, such that consecutive time slices do not overlap.
+    inline int getMaxDepartureTime() const noexcept {
+        const std::string time = getParameter("Maximum departure time");
+        return (time == "max") ? never : String::parseSeconds(time) - 1;
+    }
+
+};
+
+class MergeStopToStopShortcuts : public ParameterizedCommand {
+
+public:
+    MergeStopToStopShortcuts(BasicShell& shell) :
+        ParameterizedCommand(shell, "mergeStopToStopShortcuts", "Merges partial files written by computeStopToStopShortcutShard and saves the network with the resulting shortcut graph.") {
+        addParameter("Input file");
+        addParameter("Output file");
+        addParameter("Partial files (comma separated)");
+    }
+
+    virtual void execute() noexcept {
+        const std::string inputFile = getParameter("Input file");
+        const std::string outputFile = getParameter("Output file");
+        const std::vector<std::string> partialFiles = getParameters<std::string>("Partial files (comma separated)");
+
+        RAPTOR::Data data = RAPTOR::Data::FromBinary(inputFile);
+        data.printInfo();
+        RAPTOR::ULTRA::Builder<> shortcutGraphBuilder(data);
+        for (const std::string& partialFile : partialFiles) {
+            std::cout << "Merging shortcuts from " << partialFile << std::endl;
+            shortcutGraphBuilder.readShortcuts(partialFile);
+        }
+        shortcutGraphBuilder.buildShortcutGraph();
+        Graph::move(std::move(shortcutGraphBuilder.getShortcutGraph()), data.transferGraph);
+        Graph::printInfo(data.transferGraph);
+        data.transferGraph.printAnalysis();
+        data.serialize(outputFile);
+    }
+
+};
+
+class ComputeEventToEventShortcutShard : public ParameterizedCommand {
+
+public:
+    ComputeEventToEventShortcutShard(BasicShell& shell) :
+        ParameterizedCommand(shell, "computeEventToEventShortcutShard", "Computes the event-to-event ULTRA shortcuts for a departure time range [min, max) and the source stops of one shard (stop id modulo number of shards), and saves them as a partial file.") {
+        addParameter("Input file");
+        addParameter("Partial file");
+        addParameter("Witness limit");
+        addParameter("Minimum departure time", "min");
+        addParameter("Maximum departure time", "max");
+        addParameter("Shard", "0");
+        addParameter("Number of shards", "1");
+        addParameter("Number of threads", "max");
+        addParameter("Pin multiplier", "1");
+        addParameter("Max departures per job", "0");
+    }
+
+    virtual void execute() noexcept {
+        const std::string inputFile = getParameter("Input file");
+        const std::string partialFile = getParameter("Partial file");
+        const int witnessLimit = getParameter<int>("Witness limit");
+        const int minDepartureTime = getMinDepartureTime();
+        const int maxDepartureTime = getMaxDepartureTime();
+        const size_t shard = getParameter<size_t>("Shard");
+        const size_t numberOfShards = getParameter<size_t>("Number of shards");
+        const int numberOfThreads = getNumberOfThreads();
+        const int pinMultiplier = getParameter<int>("Pin multiplier");
+        const size_t maxDeparturesPerJob = getParameter<size_t>("Max departures per job");
+        Ensure(shard < numberOfShards, "Shard " << shard << " does not exist (number of shards: " << numberOfShards << ")!");
+
+        RAPTOR::Data raptor = RAPTOR::Data::FromBinary(inputFile);
+        raptor.printInfo();
+        TripBased::Data data(raptor);
+
+        TripBased::ULTRABuilder shortcutGraphBuilder(data);
+        std::cout << "Computing event-to-event ULTRA shortcuts for shard " << shard << " of " << numberOfShards << " (parallel with " << numberOfThreads << " threads)." << std::endl;
+        shortcutGraphBuilder.computeShortcuts(ThreadPinning(numberOfThreads, pinMultiplier), witnessLimit, minDepartureTime, maxDepartureTime, true, maxDeparturesPerJob, shard, numberOfShards);
+        std::cout << "Number of shortcuts: " << String::prettyInt(shortcutGraphBuilder.getShortcuts().size()) << std::endl;
+        shortcutGraphBuilder.writeShortcuts(partialFile);
+    }
+
+private:
+    inline int getNumberOfThreads() const noexcept {
+        if (getParameter("Number of threads") == "max") {
+            return numberOfCores();
+        } else {
+            return getParameter<int>("Number of threads");
+        }
+    }
+
+    inline int getMinDepartureTime() const noexcept {
+        const std::string time = getParameter("Minimum departure time");
+        return (time == "min") ? -never : String::parseSeconds(time);
+    }
+
+    // The maximum departure time is exclusive, such that consecutive time slices do not overlap.
+    inline int getMaxDepartureTime() const noexcept {
+        const std::string time = getParameter("Maximum departure time");
+        return (time == "max") ? never : String::parseSeconds(time) - 1;
+    }
+
+};
+
+class MergeEventToEventShortcuts : public ParameterizedCommand {
+
+public:
+    MergeEventToEventShortcuts(BasicShell& shell) :
+        ParameterizedCommand(shell, "mergeEventToEventShortcuts", "Merges partial files written by computeEventToEventShortcutShard and saves the resulting network in Trip-Based format.") {
+        addParameter("Input file");
+        addParameter("Output file");
+        addParameter("Partial files (comma separated)");
+    }
+
+    virtual void execute() noexcept {
+        const std::string inputFile = getParameter("Input file");
+        const std::string outputFile = getParameter("Output file");
+        const std::vector<std::string> partialFiles = getParameters<std::string>("Partial files (comma separated)");
+
+        RAPTOR::Data raptor = RAPTOR::Data::FromBinary(inputFile);
+        raptor.printInfo();
+        TripBased::Data data(raptor);
+
+        TripBased::ULTRABuilder shortcutGraphBuilder(data);
+        for (const std::string& partialFile : partialFiles) {
+            std::cout << "Merging shortcuts from " << partialFile << std::endl;
+            shortcutGraphBuilder.readShortcuts(partialFile);
+        }
+        shortcutGraphBuilder.buildStopEventGraph();
         Graph::move(std::move(shortcutGraphBuilder.getStopEventGraph()), data.stopEventGraph);
 
+        data.computeQueryLabels();
+        data.printInfo();
+        data.serialize(outputFile);
+    }
+
+};
+
+class RepairEventToEventShortcuts : public ParameterizedCommand {
+
+public:
+    RepairEventToEventShortcuts(BasicShell& shell) :
+        ParameterizedCommand(shell, "repairEventToEventShortcuts", "Updates the event-to-event ULTRA shortcuts of a network in Trip-Based format for a changed timetable with the same stops and transfer graph. Only the shortcut searches for departure times near removed or added trips are repeated. With a period (e.g. 86400 for a rolling window of days), the shortcuts of old trips that reappear shifted by the period are instantiated instead of recomputed, such that only non-periodic trips cause searches. No repair horizon is guaranteed to cover all affected searches, since a journey may wait arbitrarily long between two trips, so the horizon has to be given explicitly: either in seconds or as auto (twice the longest trip plus the witness limit, a heuristic). Without verification, the result may be missing shortcuts. The verification compares the result with a full recomputation and saves the recomputed shortcuts if any are missing.") {
+        addParameter("Old Trip-Based file");
+        addParameter("New RAPTOR file");
+        addParameter("Output file");
+        addParameter("Witness limit");
+        addParameter("Repair horizon (s)");
+        addParameter("Number of threads", "max");
+        addParameter("Pin multiplier", "1");
+        addParameter("Max departures per job", "0");
+        addParameter("Period (s)", "0");
+        addParameter("Verify", "false");
+    }
+
+    virtual void execute() noexcept {
+        const std::string oldFile = getParameter("Old Trip-Based file");
+        const std::string newFile = getParameter("New RAPTOR file");
+        const std::string outputFile = getParameter("Output file");
+        const int witnessLimit = getParameter<int>("Witness limit");
+        const int numberOfThreads = getNumberOfThreads();
+        const int pinMultiplier = getParameter<int>("Pin multiplier");
+        const size_t maxDeparturesPerJob = getParameter<size_t>("Max departures per job");
+        const ThreadPinning threadPinning(numberOfThreads, pinMultiplier);
+
+        TripBased::Data oldData(oldFile);
+        RAPTOR::Data raptor = RAPTOR::Data::FromBinary(newFile);
+        raptor.printInfo();
+        TripBased::Data data(raptor);
+
+        TripBased::TimetableDiff diff(oldData, data, getParameter<int>("Period (s)"));
+        diff.printInfo();
+        const int horizon = (getParameter("Repair horizon (s)") == "auto") ? diff.getDefaultHorizon(witnessLimit) : getParameter<int>("Repair horizon (s)");
+        std::cout << "Repair horizon: " << String::secToString(horizon) << std::endl;
+
+        TripBased::ULTRABuilder shortcutGraphBuilder(data);
+        const std::vector<std::pair<int, int>> affectedDepartureTimes = diff.getAffectedDepartureTimes(horizon);
+        for (const std::pair<int, int>& departureTimes : affectedDepartureTimes) {
+            std::cout << "Recomputing event-to-event ULTRA shortcuts for departures in [" << String::secToTime(departureTimes.first) << ", " << String::secToTime(departureTimes.second) << "]" << std::endl;
+        }
+        std::cout << "Running the searches of " << affectedDepartureTimes.size() << " departure time ranges (parallel with " << numberOfThreads << " threads)." << std::endl;
+        shortcutGraphBuilder.collectShortcuts(threadPinning, witnessLimit, affectedDepartureTimes, true, maxDeparturesPerJob);
+        const std::vector<TripBased::Shortcut> unchangedShortcuts = diff.getUnchangedShortcuts();
+        std::cout << "Reusing " << String::prettyInt(unchangedShortcuts.size()) << " shortcuts derived from the " << String::prettyInt(oldData.stopEventGraph.numEdges()) << " old shortcuts." << std::endl;
+        shortcutGraphBuilder.addShortcuts(unchangedShortcuts);
+        shortcutGraphBuilder.buildStopEventGraph(threadPinning, true);
+        Graph::move(std::move(shortcutGraphBuilder.getStopEventGraph()), data.stopEventGraph);
+
+        if (getParameter<bool>("Verify")) {
+            verify(data, witnessLimit, threadPinning, maxDeparturesPerJob);
+        } else {
+            warning("The repaired stop event graph was not verified and may be missing shortcuts of searches departing more than ", String::secToString(horizon), " before a changed trip!");
+        }
+
+        data.computeQueryLabels();
+        data.printInfo();
+        data.serialize(outputFile);
+    }
+
+private:
+    // Recomputes all shortcuts of the new timetable and compares them with the repaired stop event graph. If the repaired
+    // graph is missing shortcuts, it is replaced by the recomputed one.
+    inline void verify(TripBased::Data& data, const int witnessLimit, const ThreadPinning& threadPinning, const size_t maxDeparturesPerJob) const noexcept {
+        std::cout << "Verifying the repaired shortcuts with a full recomputation." << std::endl;
+        TripBased::ULTRABuilder fullBuilder(data);
+        fullBuilder.computeShortcuts(threadPinning, witnessLimit, -never, never, true, maxDeparturesPerJob);
+        SimpleStaticGraph& fullGraph = fullBuilder.getStopEventGraph();
+        size_t numberOfMissingShortcuts = 0;
+        size_t numberOfAdditionalShortcuts = 0;
+        for (const Vertex from : fullGraph.vertices()) {
+            std::vector<Vertex> fullDestinations;
+            for (const Edge edge : fullGraph.edgesFrom(from)) {
+                fullDestinations.emplace_back(fullGraph.get(ToVertex, edge));
+            }
+            std::vector<Vertex> repairedDestinations;
+            for (const Edge edge : data.stopEventGraph.edgesFrom(from)) {
+                repairedDestinations.emplace_back(data.stopEventGraph.get(ToVertex, edge));
+            }
+            std::sort(fullDestinations.begin(), fullDestinations.end());
+            std::sort(repairedDestinations.begin(), repairedDestinations.end());
+            std::vector<Vertex> difference;
+            std::set_difference(fullDestinations.begin(), fullDestinations.end(), repairedDestinations.begin(), repairedDestinations.end(), std::back_inserter(difference));
+            numberOfMissingShortcuts += difference.size();
+            difference.clear();
+            std::set_difference(repairedDestinations.begin(), repairedDestinations.end(), fullDestinations.begin(), fullDestinations.end(), std::back_inserter(difference));
+            numberOfAdditionalShortcuts += difference.size();
+        }
+        std::cout << "Shortcuts missing in the repaired graph: " << String::prettyInt(numberOfMissingShortcuts) << std::endl;
+        std::cout << "Additional shortcuts in the repaired graph: " << String::prettyInt(numberOfAdditionalShortcuts) << std::endl;
+        if (numberOfMissingShortcuts == 0) return;
+        warning("The repaired stop event graph is missing shortcuts, the recomputed shortcuts are used instead. Increase the repair horizon!");
+        Graph::move(std::move(fullGraph), data.stopEventGraph);
+    }
+
+    inline int getNumberOfThreads() const noexcept {
+        if (getParameter("Number of threads") == "max") {
+            return numberOfCores();
+        } else {
+            return getParameter<int>("Number of threads");
+        }
+    }
+
+};
+
+class EstimatePreprocessing : public ParameterizedCommand {
+
+public:
+    EstimatePreprocessing(BasicShell& shell) :
+        ParameterizedCommand(shell, "estimatePreprocessing", "Runs the preprocessing for a random sample of source stops (or trips for raptorToTripBased) and extrapolates running time, number of shortcuts and additional peak memory of the full run. The sampled sources are searched independently, so shortcuts that the full run finds once or prunes are counted for every source, and the shortcut counts are upper bounds.") {
+        addParameter("Input file");
+        addParameter("Preprocessing", {"computeEventToEventShortcuts", "computeStopToStopShortcuts", "raptorToTripBased"});
+        addParameter("Sample size", "100");
+        addParameter("Witness limits (comma separated)", "900");
+        addParameter("Number of threads", "max");
+        addParameter("Seed", "42");
+    }
+
+    virtual void execute() noexcept {
+        const std::string inputFile = getParameter("Input file");
+        const std::string preprocessing = getParameter("Preprocessing");
+        const std::vector<int> witnessLimits = getParameters<int>("Witness limits (comma separated)");
+
+        RAPTOR::Data raptor = RAPTOR::Data::FromBinary(inputFile);
+        raptor.printInfo();
+        if (preprocessing == "computeStopToStopShortcuts") {
+            for (const int witnessLimit : witnessLimits) {
+                estimateStopToStopShortcuts(raptor, witnessLimit);
+            }
+            return;
+        }
+        TripBased::Data data(raptor);
+        if (preprocessing == "computeEventToEventShortcuts") {
+            const std::vector<TripBased::ShortcutSearch<>::Station> stationOfStop = TripBased::ShortcutSearch<>::ComputeStationOfStop(data.raptorData);
+            for (const int witnessLimit : witnessLimits) {
+                estimateEventToEventShortcuts(data, stationOfStop, witnessLimit);
+            }
+        } else {
+            estimateStopEventGraph(data);
+        }
+    }
+
+private:
+    inline void estimateEventToEventShortcuts(const TripBased::Data& data, const std::vector<TripBased::ShortcutSearch<>::Station>& stationOfStop, const int witnessLimit) const noexcept {
+        SampleEstimate time(data.numberOfStops());
+        SampleEstimate shortcuts(data.numberOfStops());
+        TripBased::ShortcutSearch<> shortcutSearch(data, stationOfStop, witnessLimit);
+        Timer timer;
+        for (const size_t stop : getSample(data.numberOfStops())) {
+            const size_t numberOfShortcuts = shortcutSearch.getShortcuts().size();
+            timer.restart();
+            shortcutSearch.run(StopId(stop), -never, never);
+            time.add(timer.elapsedMilliseconds());
+            shortcuts.add(shortcutSearch.getShortcuts().size() - numberOfShortcuts);
+        }
+        // Thread-local and merged shortcut lists, or the merged list with the sort buffers and the resulting graph.
+        const auto memory = [&](const double numberOfShortcuts) {
+            const double listSize = numberOfShortcuts * sizeof(TripBased::Shortcut);
+            return std::max(2 * listSize, listSize + numberOfShortcuts * 2 * sizeof(Vertex) + data.numberOfStopEvents() * (2 * sizeof(size_t) + sizeof(Edge)));
+        };
+        printEstimate("computeEventToEventShortcuts with witness limit " + std::to_string(witnessLimit), "stops", "Shortcuts (with duplicates)", time, shortcuts, memory);
+    }
+
+    // Every sampled source starts with an empty shortcut graph, such that its shortcuts do not depend on the sources
+    // sampled before it. The full run prunes with the shortcuts that the same thread found for earlier sources and stores
+    // every shortcut once, so the extrapolated number of shortcuts (and with it the running time) is an upper bound.
+    inline void estimateStopToStopShortcuts(const RAPTOR::Data& data, const int witnessLimit) const noexcept {
+        SampleEstimate time(data.numberOfStops());
+        SampleEstimate shortcuts(data.numberOfStops());
+        DynamicTransferGraph shortcutGraph;
+        long long graphBytes = 0;
+        size_t graphEdges = 0;
+        RAPTOR::ULTRA::ShortcutSearch<> shortcutSearch(data, shortcutGraph, witnessLimit);
+        Timer timer;
+        for (const size_t stop : getSample(data.numberOfStops())) {
+            shortcutGraph.clear();
+            shortcutGraph.addVertices(data.numberOfStops());
+            const long long emptyGraphSize = shortcutGraph.byteSize();
+            timer.restart();
+            shortcutSearch.run(StopId(stop), -never, never);
+            time.add(timer.elapsedMilliseconds());
+            shortcuts.add(shortcutGraph.numEdges());
+            graphBytes += shortcutGraph.byteSize() - emptyGraphSize;
+            graphEdges += shortcutGraph.numEdges();
+        }
+        // Every thread keeps its shortcuts in a dynamic graph for pruning, in addition to the shortcut lists.
+        const double graphBytesPerShortcut = (graphEdges == 0) ? 0 : double(graphBytes) / graphEdges;
+        const auto memory = [&](const double numberOfShortcuts) {
+            return numberOfShortcuts * (graphBytesPerShortcut + 2 * sizeof(RAPTOR::Shortcut));
+        };
+        printEstimate("computeStopToStopShortcuts with witness limit " + std::to_string(witnessLimit), "stops", "Shortcuts (with duplicates)", time, shortcuts, memory);
+    }
+
+    inline void estimateStopEventGraph(const TripBased::Data& data) const noexcept {
+        SampleEstimate time(data.numberOfTrips());
+        SampleEstimate edges(data.numberOfTrips());
+        std::vector<Edge> outDegree(data.numberOfStopEvents() + 1, Edge(0));
+        TripBased::StopEventGraphBuilder builder(data);
+        Timer timer;
+        for (const size_t trip : getSample(data.numberOfTrips())) {
+            timer.restart();
+            builder.computeEdges(TripId(trip), outDegree);
+            time.add(timer.elapsedMilliseconds());
+            const StopEventId firstEvent = data.firstStopEventOfTrip[trip];
+            size_t numberOfEdges = 0;
+            for (size_t i = 0; i < data.numberOfStopsInTrip(TripId(trip)); i++) {
+                numberOfEdges += outDegree[firstEvent + i + 1];
+            }
+            edges.add(numberOfEdges);
+        }
+        // Thread-local edge buffers and the resulting graph.
+        const auto memory = [&](const double numberOfEdges) {
+            return numberOfEdges * 2 * sizeof(Vertex) + data.numberOfStopEvents() * sizeof(Edge);
+        };
+        printEstimate("raptorToTripBased", "trips", "Transfers", time, edges, memory);
+    }
+
+    inline std::vector<size_t> getSample(const size_t populationSize) const noexcept {
+        std::vector<size_t> sample(populationSize);
+        std::iota(sample.begin(), sample.end(), 0);
+        std::mt19937 randomGenerator(getParameter<int>("Seed"));
+        std::shuffle(sample.begin(), sample.end(), randomGenerator);
+        sample.resize(std::min(populationSize, getParameter<size_t>("Sample size")));
+        return sample;
+    }
+
+    template<typename MEMORY_FUNCTION>
+    inline void printEstimate(const std::string& name, const std::string& population, const std::string& edgeName, const SampleEstimate& time, const SampleEstimate& edges, const MEMORY_FUNCTION& memory) const noexcept {
+        const int numberOfThreads = getNumberOfThreads();
+        std::cout << "Estimate for " << name << " (sample of " << String::prettyInt(time.sampleSize()) << " " << population << ", 95% confidence interval):" << std::endl;
+        std::cout << "   Running time with " << numberOfThreads << " threads: " << timeToString(time.total() / numberOfThreads) << " [" << timeToString(time.lowerBound() / numberOfThreads) << ", " << timeToString(time.upperBound() / numberOfThreads) << "]" << std::endl;
+        std::cout << "   " << edgeName << ": " << String::prettyInt(size_t(edges.total())) << " [" << String::prettyInt(size_t(edges.lowerBound())) << ", " << String::prettyInt(size_t(edges.upperBound())) << "]" << std::endl;
+        std::cout << "   Additional peak memory: " << String::bytesToString(memory(edges.total())) << " [" << String::bytesToString(memory(edges.lowerBound())) << ", " << String::bytesToString(memory(edges.upperBound())) << "]" << std::endl;
+    }
+
+    inline static std::string timeToString(const double milliseconds) noexcept {
+        return (milliseconds < 60000) ? String::msToString(milliseconds) : String::secToString(milliseconds / 1000);
+    }
+
+    inline int getNumberOfThreads() const noexcept {
+        if (getParameter("Number of threads") == "max") {
+            return numberOfCores();
+        } else {
+            return getParameter<int>("Number of threads");
+        }
+    }
+
+};
+
+class MakeTripBasedMappable : public ParameterizedCommand {
+
+public:
+    MakeTripBasedMappable(BasicShell& shell) :
+        ParameterizedCommand(shell, "makeTripBasedMappable", "Saves a network in Trip-Based format such that its stop events, route segments, arrival events and query labels are memory mapped when it is loaded. The stop event graph and the transfer graph are still read into memory.") {
+        addParameter("Input file");
+        addParameter("Output file");
+    }
+
+    virtual void execute() noexcept {
+        const std::string inputFile = getParameter("Input file");
+        const std::string outputFile = getParameter("Output file");
+
+        TripBased::Data data(inputFile);
+        data.printInfo();
+        data.serializeMappable(outputFile);
+    }
+
+};
+
+class ComputeArcFlags : public ParameterizedCommand {
+
+public:
+    ComputeArcFlags(BasicShell& shell) :
+        ParameterizedCommand(shell, "computeArcFlags", "Partitions the stops of a Trip-Based network into cells and computes arc flags for its shortcuts.") {
+        addParameter("Input file");
+        addParameter("Output file");
+        addParameter("Number of cells", "16");
+        addParameter("Number of threads", "max");
+        addParameter("Pin multiplier", "1");
+        addParameter("Seed", "42");
+    }
+
+    virtual void execute() noexcept {
+        const std::string inputFile = getParameter("Input file");
+        const std::string outputFile = getParameter("Output file");
+        const size_t numberOfCells = getParameter<size_t>("Number of cells");
+        const int numberOfThreads = getNumberOfThreads();
+        const int pinMultiplier = getParameter<int>("Pin multiplier");
+        const int seed = getParameter<int>("Seed");
+
+        TripBased::Data data(inputFile);
         data.printInfo();
+        TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+            using ReachedIndex = typename decltype(reachedIndex)::Type;
+            Timer timer;
+            TripBased::ArcFlagBuilder<ReachedIndex> builder(data);
+            builder.computeCells(numberOfCells, seed);
+            std::cout << "Partitioned the stops into " << numberOfCells << " cells in " << String::msToString(timer.elapsedMilliseconds()) << std::endl;
+            builder.computeFlags(ThreadPinning(numberOfThreads, pinMultiplier));
+            std::cout << "Computed the arc flags in " << String::msToString(timer.elapsedMilliseconds()) << std::endl;
+        });
+        std::cout << "Size of the arc flags: " << String::bytesToString(Vector::byteSize(data.arcFlags) + Vector::byteSize(data.cellOfStop)) << " (" << data.arcFlagBytes << " bytes per edge)" << std::endl;
         data.serialize(outputFile);
     }
 
@@ -21,7 +21,9 @@
 #pragma once
 
 #include <iostream>
+#include <iomanip>
 #include <algorithm>
+#include <memory>
 #include <random>
 #include <vector>
 #include <string>
@@ -32,10 +34,18 @@
 #include "../../DataStructures/RAPTOR/Data.h"
 #include "../../DataStructures/TripBased/Data.h"
 
+#include "../../Algorithms/CH/Query/BucketGraph.h"
 #include "../../Algorithms/RAPTOR/ULTRARAPTOR.h"
+#include "../../Algorithms/TripBased/Query/BackwardQuery.h"
+#include "../../Algorithms/TripBased/Query/OneToAllQuery.h"
+#include "../../Algorithms/TripBased/Query/ProfileQuery.h"
 #include "../../Algorithms/TripBased/Query/Query.h"
 #include "../../Algorithms/TripBased/Query/TransitiveQuery.h"
 
+#include "../../Helpers/Console/Progress.h"
+#include "../../Helpers/IO/File.h"
+#include "../../Helpers/MultiThreading.h"
+
 using namespace Shell;
 
 namespace ULTRA {
@@ -63,6 +73,68 @@ struct TargetDistance {
     double distance;
 };
 
+inline bool equals(const std::vector<TripBased::Journey>& a, const std::vector<TripBased::Journey>& b) noexcept {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if ((a[i].arrivalTime != b[i].arrivalTime) || (a[i].numberOfUsedVehicles != b[i].numberOfUsedVehicles)) return false;
+    }
+    return true;
+}
+
+// Compares the running times of two ULTRA-Trip-Based query variants, grouped by the Geo-Rank of the queries, and counts the
+// queries for which their journeys differ. Afterwards, the debug statistics of both variants are printed.
+template<typename QUERY, typename OTHER_QUERY>
+inline void compareQueriesByGeoRank(const TripBased::Data& data, const CH::CH& ch, const std::shared_ptr<const CH::BucketGraph>& bucketGraph, const std::vector<Query>& queries, const std::string& name, const std::string& otherName) noexcept {
+    QUERY query(data, ch, bucketGraph);
+    OTHER_QUERY otherQuery(data, ch, bucketGraph);
+
+    int maxRank = 0;
+    for (const Query& q : queries) {
+        maxRank = std::max(maxRank, q.geoRank);
+    }
+    std::vector<size_t> numberOfQueries(maxRank + 1, 0);
+    std::vector<double> queryTime(maxRank + 1, 0);
+    std::vector<double> otherQueryTime(maxRank + 1, 0);
+    size_t numberOfMismatches = 0;
+
+    Timer timer;
+    for (const Query& q : queries) {
+        timer.restart();
+        query.run(q.source, q.departureTime, q.target);
+        queryTime[q.geoRank] += timer.elapsedMilliseconds();
+        timer.restart();
+        otherQuery.run(q.source, q.departureTime, q.target);
+        otherQueryTime[q.geoRank] += timer.elapsedMilliseconds();
+        numberOfQueries[q.geoRank]++;
+        if (!equals(query.getJourneys(), otherQuery.getJourneys())) numberOfMismatches++;
+    }
+
+    std::cout << std::setw(8) << "Rank" << std::setw(10) << "Queries" << std::setw(16) << (name + " [ms]") << std::setw(16) << (otherName + " [ms]") << std::setw(12) << "Speedup" << std::endl;
+    for (int rank = 0; rank <= maxRank; rank++) {
+        if (numberOfQueries[rank] == 0) continue;
+        std::cout << std::setw(8) << rank
+                  << std::setw(10) << String::prettyInt(numberOfQueries[rank])
+                  << std::setw(16) << String::prettyDouble(queryTime[rank] / numberOfQueries[rank], 3)
+                  << std::setw(16) << String::prettyDouble(otherQueryTime[rank] / numberOfQueries[rank], 3)
+                  << std::setw(12) << String::prettyDouble(queryTime[rank] / otherQueryTime[rank], 2) << std::endl;
+    }
+    const double totalQueryTime = Vector::sum(queryTime);
+    const double totalOtherQueryTime = Vector::sum(otherQueryTime);
+    std::cout << "Total: " << String::prettyDouble(totalQueryTime / queries.size(), 3) << "ms vs. " << String::prettyDouble(totalOtherQueryTime / queries.size(), 3) << "ms per query (speedup " << String::prettyDouble(totalQueryTime / totalOtherQueryTime, 2) << ")" << std::endl;
+    std::cout << "Queries with differing journeys: " << String::prettyInt(numberOfMismatches) << std::endl;
+
+    typename QUERY::DebugType debugQuery(data, ch, bucketGraph);
+    typename OTHER_QUERY::DebugType otherDebugQuery(data, ch, bucketGraph);
+    for (const Query& q : queries) {
+        debugQuery.run(q.source, q.departureTime, q.target);
+        otherDebugQuery.run(q.source, q.departureTime, q.target);
+    }
+    std::cout << std::endl << name << ":" << std::endl;
+    debugQuery.debug(queries.size());
+    std::cout << std::endl << otherName << ":" << std::endl;
+    otherDebugQuery.debug(queries.size());
+}
+
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// GenerateUltraQueries //////////////////////////////////////////////////////////////////////
@@ -175,13 +247,20 @@ class RunUltraQueries : public ParameterizedCommand {
 
 public:
     RunUltraQueries(BasicShell& shell) :
-        ParameterizedCommand(shell, "runUltraQueries", "Evaluates random ULTRA queries.") {
+        ParameterizedCommand(shell, "runUltraQueries", "Evaluates random ULTRA queries."),
+        numberOfThreads(1),
+        pinMultiplier(1),
+        scalingTest(false) {
         addParameter("Network file");
         addParameter("CH file");
         addParameter("Query file");
         addParameter("Result file");
         addParameter("Query type", {"RAPTOR", "Trip-Based", "Trip-Based*"});
         addParameter("Debug", "true", {"true", "false"});
+        addParameter("Number of threads", "1");
+        addParameter("Pin multiplier", "1");
+        addParameter("Scaling test", "false", {"true", "false"});
+        addParameter("Reached index", "Copy", {"Copy", "Timestamp"});
     }
 
     virtual void execute() noexcept {
@@ -191,6 +270,9 @@ public:
         const std::string resultFileName = getParameter("Result file");
         const std::string queryType = getParameter("Query type");
         const bool debug = getParameter<bool>("Debug");
+        numberOfThreads = getNumberOfThreads();
+        pinMultiplier = getParameter<size_t>("Pin multiplier");
+        scalingTest = getParameter<bool>("Scaling test");
 
         std::vector<ULTRA::Query> queries;
         IO::deserialize(queryFile, queries);
@@ -199,32 +281,23 @@ public:
             CH::CH ch(chFile);
             RAPTOR::Data data(networkFile);
             data.useImplicitDepartureBufferTimes();
+            const std::shared_ptr<const CH::BucketGraph> bucketGraph = CH::BucketGraph::FromCH(ch, chFile, data.numberOfStops(), ThreadPinning(numberOfThreads, pinMultiplier));
             if (debug) {
-                RAPTOR::ULTRARAPTOR<RAPTOR::SimpleDebugger> algorithm(data, ch);
-                runQueries(algorithm, queries);
+                runQueries<RAPTOR::ULTRARAPTOR<RAPTOR::SimpleDebugger>>(queries, data, ch, bucketGraph);
             } else {
-                RAPTOR::ULTRARAPTOR<RAPTOR::NoDebugger> algorithm(data, ch);
-                runQueries(algorithm, queries);
+                runQueries<RAPTOR::ULTRARAPTOR<RAPTOR::NoDebugger>>(queries, data, ch, bucketGraph);
             }
-        } else if (queryType == "Trip-Based") {
-            CH::CH ch(chFile);
+        } else {
             TripBased::Data data(networkFile);
-            if (debug) {
-                TripBased::Query<TripBased::ReachedIndexSmall, true> algorithm(data, ch);
-                runQueries(algorithm, queries);
+            if (queryType == "Trip-Based*") data.printInfo();
+            if (getParameter("Reached index") == "Timestamp") {
+                TripBased::chooseReachedIndex<TripBased::ReachedIndexTimestampImplementation>(data, [&](const auto reachedIndex) {
+                    runTripBasedQueries<typename decltype(reachedIndex)::Type>(queries, data, chFile, queryType, debug);
+                });
             } else {
-                TripBased::Query<TripBased::ReachedIndexSmall, false> algorithm(data, ch);
-                runQueries(algorithm, queries);
-            }
-        } else if (queryType == "Trip-Based*") {
-            TripBased::Data data(networkFile);
-            data.printInfo();
-            if (debug) {
-                TripBased::TransitiveQuery<TripBased::ReachedIndexSmall, true> algorithm(data);
-                runQueries(algorithm, queries);
-            } else {
-                TripBased::TransitiveQuery<TripBased::ReachedIndexSmall, false> algorithm(data);
-                runQueries(algorithm, queries);
+                TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+                    runTripBasedQueries<typename decltype(reachedIndex)::Type>(queries, data, chFile, queryType, debug);
+                });
             }
         }
 
@@ -237,6 +310,66 @@ public:
     }
 
 private:
+    inline size_t getNumberOfThreads() const noexcept {
+        if (getParameter("Number of threads") == "max") {
+            return numberOfCores();
+        } else {
+            return getParameter<size_t>("Number of threads");
+        }
+    }
+
+    template<typename REACHED_INDEX>
+    inline void runTripBasedQueries(std::vector<ULTRA::Query>& queries, const TripBased::Data& data, const std::string& chFile, const std::string& queryType, const bool debug) {
+        std::cout << "Using reached index with " << (sizeof(typename REACHED_INDEX::Label) * 8) << "-bit labels" << std::endl;
+        if (queryType == "Trip-Based") {
+            CH::CH ch(chFile);
+            const std::shared_ptr<const CH::BucketGraph> bucketGraph = CH::BucketGraph::FromCH(ch, chFile, data.numberOfStops(), ThreadPinning(numberOfThreads, pinMultiplier));
+            if (debug) {
+                runQueries<TripBased::Query<REACHED_INDEX, true>>(queries, data, ch, bucketGraph);
+            } else {
+                runQueries<TripBased::Query<REACHED_INDEX, false>>(queries, data, ch, bucketGraph);
+            }
+        } else if (queryType == "Trip-Based*") {
+            if (debug) {
+                runQueries<TripBased::TransitiveQuery<REACHED_INDEX, true>>(queries, data);
+            } else {
+                runQueries<TripBased::TransitiveQuery<REACHED_INDEX, false>>(queries, data);
+            }
+        }
+    }
+
+    template<typename ALGORITHM, typename... ARGUMENTS>
+    inline void runQueries(std::vector<ULTRA::Query>& queries, const ARGUMENTS&... arguments) {
+        if (!scalingTest) {
+            if (numberOfThreads <= 1) {
+                ALGORITHM algorithm(arguments...);
+                runQueries(algorithm, queries);
+            } else {
+                runQueriesParallel<ALGORITHM>(queries, numberOfThreads, true, arguments...);
+            }
+            return;
+        }
+        std::vector<size_t> threadCounts;
+        for (size_t threads = 1; threads < numberOfThreads; threads *= 2) {
+            threadCounts.emplace_back(threads);
+        }
+        threadCounts.emplace_back(numberOfThreads);
+        std::vector<double> times;
+        for (const size_t threads : threadCounts) {
+            times.emplace_back(runQueriesParallel<ALGORITHM>(queries, threads, threads == numberOfThreads, arguments...));
+        }
+        std::cout << std::endl << "Scaling:" << std::endl;
+        std::cout << std::setw(10) << "Threads" << std::setw(16) << "Time" << std::setw(16) << "Queries/s" << std::setw(12) << "Speedup" << std::setw(12) << "Efficiency" << std::endl;
+        for (size_t i = 0; i < threadCounts.size(); i++) {
+            const double speedup = times[0] / times[i];
+            std::cout << std::setw(10) << threadCounts[i]
+                      << std::setw(16) << String::msToString(times[i])
+                      << std::setw(16) << String::prettyDouble(queriesPerSecond(queries.size(), times[i]), 0)
+                      << std::setw(12) << String::prettyDouble(speedup, 2)
+                      << std::setw(12) << String::percent(speedup / threadCounts[i]) << std::endl;
+        }
+    }
+
     template<typename ALGORITHM>
     inline void runQueries(ALGORITHM& algorithm, std::vector<ULTRA::Query>& queries) {
         std::cout << "Evaluating " << String::prettyInt(queries.size()) << " queries..." << std::endl;
@@ -250,8 +383,835 @@ private:
             query.numberOfTrips = algorithm.getEarliestArrivalNumberOfTrips();
         }
         const double time = timer.elapsedMilliseconds();
-        std::cout << "Done in " << String::msToString(time) << " (" << String::prettyDouble(time / queries.size(), 1) << "ms per query)" << std::endl;
+        std::cout << "Done in " << String::msToString(time) << " (" << String::prettyDouble(time / queries.size(), 1) << "ms per query, " << String::prettyDouble(queriesPerSecond(queries.size(), time), 0) << " queries/s)" << std::endl;
         algorithm.debug(queries.size());
     }
 
+    // Every thread owns its own query object, the network and the CH are shared read-only. Queries are
+    // handed out dynamically and every result is written to the position of its query, such that the
+    // result file does not depend on the number of threads or the scheduling.
+    template<typename ALGORITHM, typename... ARGUMENTS>
+    inline double runQueriesParallel(std::vector<ULTRA::Query>& queries, const size_t threads, const bool printStatistics, const ARGUMENTS&... arguments) {
+        std::cout << "Evaluating " << String::prettyInt(queries.size()) << " queries (parallel with " << threads << " threads)..." << std::endl;
+        const ThreadPinning threadPinning(threads, pinMultiplier);
+        std::vector<size_t> queriesPerThread(threads, 0);
+        Timer timer;
+        double time = 0;
+        omp_set_num_threads(threads);
+        #pragma omp parallel
+        {
+            threadPinning.pinThread();
+            const size_t threadId = omp_get_thread_num();
+
+            ALGORITHM algorithm(arguments...);
+            Timer queryTimer;
+
+            #pragma omp barrier
+            #pragma omp single
+            timer.restart();
+
+            #pragma omp for schedule(dynamic, 8)
+            for (size_t i = 0; i < queries.size(); i++) {
+                ULTRA::Query& query = queries[i];
+                queryTimer.restart();
+                algorithm.run(query.source, query.departureTime, query.target);
+                query.queryTime = queryTimer.elapsedMilliseconds();
+                query.earliestArrivalTime = algorithm.getEarliestArrivalTime();
+                query.numberOfTrips = algorithm.getEarliestArrivalNumberOfTrips();
+                queriesPerThread[threadId]++;
+            }
+
+            #pragma omp single
+            time = timer.elapsedMilliseconds();
+
+            if (printStatistics) {
+                #pragma omp for ordered schedule(static, 1)
+                for (size_t i = 0; i < threads; i++) {
+                    #pragma omp ordered
+                    {
+                        std::cout << "Thread " << threadId << " (" << String::prettyInt(queriesPerThread[threadId]) << " queries):" << std::endl;
+                        algorithm.debug(std::max<size_t>(queriesPerThread[threadId], 1));
+                    }
+                }
+            }
+        }
+        std::cout << "Done in " << String::msToString(time) << " (" << String::prettyDouble(queriesPerSecond(queries.size(), time), 0) << " queries/s)" << std::endl;
+        return time;
+    }
+
+    inline static double queriesPerSecond(const size_t numberOfQueries, const double milliseconds) noexcept {
+        return (milliseconds > 0) ? (numberOfQueries * 1000.0 / milliseconds) : 0.0;
+    }
+
+private:
+    size_t numberOfThreads;
+    size_t pinMultiplier;
+    bool scalingTest;
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// RunProfileQueries //////////////////////////////////////////////////////////////////////
+class RunProfileQueries : public ParameterizedCommand {
+
+public:
+    RunProfileQueries(BasicShell& shell) :
+        ParameterizedCommand(shell, "runProfileQueries", "Evaluates ULTRA-Trip-Based range queries and compares them to independent queries for every departure time.") {
+        addParameter("Trip-Based file");
+        addParameter("CH file");
+        addParameter("Query file");
+        addParameter("Range", "02:00:00");
+        addParameter("Compare", "true", {"true", "false"});
+        addParameter("Debug", "false", {"true", "false"});
+    }
+
+    virtual void execute() noexcept {
+        const std::string tripBasedFile = getParameter("Trip-Based file");
+        const std::string chFile = getParameter("CH file");
+        const std::string queryFile = getParameter("Query file");
+        const int range = String::parseSeconds(getParameter("Range"));
+        const bool compare = getParameter<bool>("Compare");
+
+        std::vector<ULTRA::Query> queries;
+        IO::deserialize(queryFile, queries);
+        CH::CH ch(chFile);
+        TripBased::Data data(tripBasedFile);
+        const std::shared_ptr<const CH::BucketGraph> bucketGraph = CH::BucketGraph::FromCH(ch, chFile, data.numberOfStops());
+
+        const bool debug = getParameter<bool>("Debug");
+        TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+            using ReachedIndex = typename decltype(reachedIndex)::Type;
+            if (debug) {
+                run<ReachedIndex, TripBased::ProfileQuery<ReachedIndex, true>>(data, ch, bucketGraph, queries, range, compare);
+            } else {
+                run<ReachedIndex, TripBased::ProfileQuery<ReachedIndex, false>>(data, ch, bucketGraph, queries, range, compare);
+            }
+        });
+    }
+
+private:
+    template<typename REACHED_INDEX, typename PROFILE_QUERY>
+    inline void run(const TripBased::Data& data, const CH::CH& ch, const std::shared_ptr<const CH::BucketGraph>& bucketGraph, const std::vector<ULTRA::Query>& queries, const int range, const bool compare) noexcept {
+        PROFILE_QUERY profileQuery(data, ch, bucketGraph);
+        TripBased::Query<REACHED_INDEX, false> query(data, ch, bucketGraph);
+
+        std::cout << "Evaluating " << String::prettyInt(queries.size()) << " range queries..." << std::endl;
+        double profileTime = 0;
+        double independentTime = 0;
+        size_t numberOfDepartureTimes = 0;
+        size_t numberOfJourneys = 0;
+        size_t numberOfMismatches = 0;
+        std::vector<TripBased::ProfileJourney> expectedProfile;
+        Timer timer;
+        for (const ULTRA::Query& q : queries) {
+            timer.restart();
+            profileQuery.run(q.source, q.departureTime, q.departureTime + range, q.target);
+            profileTime += timer.elapsedMilliseconds();
+            numberOfJourneys += profileQuery.getProfile().size();
+            const std::vector<int> departureTimes = profileQuery.getDepartureTimes();
+            numberOfDepartureTimes += departureTimes.size();
+            if (!compare) continue;
+
+            // Reference solution: One query per departure time (and one after the range, since its journeys dominate),
+            // of which only the Pareto-optimal journeys are kept.
+            timer.restart();
+            expectedProfile.clear();
+            query.run(q.source, q.departureTime + range + 1, q.target);
+            std::vector<int> minArrivalTimes = getMinArrivalTimes(query.getJourneys());
+            for (const int departureTime : departureTimes) {
+                query.run(q.source, departureTime, q.target);
+                const std::vector<int> arrivalTimes = getMinArrivalTimes(query.getJourneys());
+                for (size_t i = 1; i < arrivalTimes.size(); i++) {
+                    if (arrivalTimes[i] >= arrivalTimes[i - 1]) continue;
+                    if (arrivalTimes[i] >= ((i < minArrivalTimes.size()) ? minArrivalTimes[i] : minArrivalTimes.back())) continue;
+                    expectedProfile.emplace_back(departureTime, arrivalTimes[i], i);
+                }
+                if (arrivalTimes.size() > minArrivalTimes.size()) minArrivalTimes.resize(arrivalTimes.size(), minArrivalTimes.back());
+                for (size_t i = 0; i < minArrivalTimes.size(); i++) {
+                    minArrivalTimes[i] = std::min(minArrivalTimes[i], (i < arrivalTimes.size()) ? arrivalTimes[i] : arrivalTimes.back());
+                }
+            }
+            independentTime += timer.elapsedMilliseconds();
+            std::reverse(expectedProfile.begin(), expectedProfile.end());
+            if (expectedProfile != profileQuery.getProfile()) numberOfMismatches++;
+        }
+
+        std::cout << "Departure times per query: " << String::prettyDouble(numberOfDepartureTimes / static_cast<double>(queries.size()), 1) << std::endl;
+        std::cout << "Profile journeys per query: " << String::prettyDouble(numberOfJourneys / static_cast<double>(queries.size()), 1) << std::endl;
+        std::cout << "Range query time: " << String::msToString(profileTime) << " (" << String::prettyDouble(profileTime / queries.size(), 3) << "ms per query)" << std::endl;
+        if (compare) {
+            std::cout << "Independent queries time: " << String::msToString(independentTime) << " (" << String::prettyDouble(independentTime / queries.size(), 3) << "ms per query)" << std::endl;
+            std::cout << "Speedup: " << String::prettyDouble(independentTime / profileTime, 2) << std::endl;
+            std::cout << "Queries with differing profiles: " << String::prettyInt(numberOfMismatches) << std::endl;
+        }
+        profileQuery.debug(queries.size());
+    }
+
+    // Converts the Pareto set of a single query into the minimum arrival time per maximum number of trips.
+    inline static std::vector<int> getMinArrivalTimes(const std::vector<TripBased::Journey>& journeys) noexcept {
+        std::vector<int> result(1, INFTY);
+        for (const TripBased::Journey& journey : journeys) {
+            if (journey.numberOfUsedVehicles >= result.size()) result.resize(journey.numberOfUsedVehicles + 1, result.back());
+            result[journey.numberOfUsedVehicles] = journey.arrivalTime;
+        }
+        return result;
+    }
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// RunArriveByQueries //////////////////////////////////////////////////////////////////////
+class RunArriveByQueries : public ParameterizedCommand {
+
+public:
+    RunArriveByQueries(BasicShell& shell) :
+        ParameterizedCommand(shell, "runArriveByQueries", "Evaluates ULTRA-Trip-Based latest departure queries and compares them to bisection over departure times.") {
+        addParameter("Trip-Based file");
+        addParameter("CH file");
+        addParameter("Query file");
+        addParameter("Compare", "true", {"true", "false"});
+        addParameter("Debug", "false", {"true", "false"});
+    }
+
+    virtual void execute() noexcept {
+        const std::string tripBasedFile = getParameter("Trip-Based file");
+        const std::string chFile = getParameter("CH file");
+        const std::string queryFile = getParameter("Query file");
+        const bool compare = getParameter<bool>("Compare");
+
+        std::vector<ULTRA::Query> queries;
+        IO::deserialize(queryFile, queries);
+        CH::CH ch(chFile);
+        TripBased::Data data(tripBasedFile);
+        Timer timer;
+        const TripBased::Data reverseData = data.reverseNetwork();
+        std::cout << "Reversed the network in " << String::msToString(timer.elapsedMilliseconds()) << std::endl;
+        const std::shared_ptr<const CH::BucketGraph> bucketGraph = CH::BucketGraph::FromCH(ch, chFile, data.numberOfStops());
+
+        const bool debug = getParameter<bool>("Debug");
+        TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+            using ReachedIndex = typename decltype(reachedIndex)::Type;
+            if (debug) {
+                run<ReachedIndex, TripBased::BackwardQuery<ReachedIndex, true>>(data, reverseData, ch, bucketGraph, queries, compare);
+            } else {
+                run<ReachedIndex, TripBased::BackwardQuery<ReachedIndex, false>>(data, reverseData, ch, bucketGraph, queries, compare);
+            }
+        });
+    }
+
+private:
+    template<typename REACHED_INDEX, typename BACKWARD_QUERY>
+    inline void run(const TripBased::Data& data, const TripBased::Data& reverseData, const CH::CH& ch, const std::shared_ptr<const CH::BucketGraph>& bucketGraph, const std::vector<ULTRA::Query>& queries, const bool compare) noexcept {
+        BACKWARD_QUERY backwardQuery(reverseData, ch, bucketGraph);
+        TripBased::Query<REACHED_INDEX, false> query(data, ch, bucketGraph);
+
+        // The arrival time of every query is the earliest arrival time for its departure time, such that the
+        // latest departure time is at least the departure time of the query.
+        std::vector<int> arrivalTimes;
+        for (const ULTRA::Query& q : queries) {
+            query.run(q.source, q.departureTime, q.target);
+            arrivalTimes.emplace_back(query.getEarliestArrivalTime());
+        }
+
+        std::cout << "Evaluating " << String::prettyInt(queries.size()) << " latest departure queries..." << std::endl;
+        double backwardTime = 0;
+        double bisectionTime = 0;
+        size_t numberOfQueries = 0;
+        size_t numberOfJourneys = 0;
+        size_t numberOfBisectionSteps = 0;
+        size_t numberOfMismatches = 0;
+        Timer timer;
+        for (size_t i = 0; i < queries.size(); i++) {
+            const ULTRA::Query& q = queries[i];
+            if (arrivalTimes[i] >= INFTY) continue;
+            numberOfQueries++;
+            timer.restart();
+            backwardQuery.run(q.source, arrivalTimes[i], q.target);
+            backwardTime += timer.elapsedMilliseconds();
+            const std::vector<TripBased::ArriveByJourney> journeys = backwardQuery.getJourneys();
+            numberOfJourneys += journeys.size();
+            if (!compare) continue;
+
+            // Reference solution: Bisection over the departure time, with one query per step.
+            timer.restart();
+            int feasible = q.departureTime;
+            int infeasible = arrivalTimes[i] + 1;
+            while (infeasible - feasible > 1) {
+                const int departureTime = feasible + ((infeasible - feasible) / 2);
+                query.run(q.source, departureTime, q.target);
+                numberOfBisectionSteps++;
+                if (query.getEarliestArrivalTime() <= arrivalTimes[i]) {
+                    feasible = departureTime;
+                } else {
+                    infeasible = departureTime;
+                }
+            }
+            bisectionTime += timer.elapsedMilliseconds();
+            bool mismatch = (backwardQuery.getLatestDepartureTime() != feasible);
+
+            // Every journey of the Pareto set must be tight: departing one second later is not possible with
+            // the same number of trips.
+            for (const TripBased::ArriveByJourney& journey : journeys) {
+                if (mismatch) break;
+                query.run(q.source, journey.departureTime, q.target);
+                mismatch = (getMinArrivalTime(query.getJourneys(), journey.numberOfUsedVehicles) > arrivalTimes[i]);
+                query.run(q.source, journey.departureTime + 1, q.target);
+                mismatch |= (getMinArrivalTime(query.getJourneys(), journey.numberOfUsedVehicles) <= arrivalTimes[i]);
+            }
+            if (mismatch) numberOfMismatches++;
+        }
+
+        std::cout << "Answered queries: " << String::prettyInt(numberOfQueries) << std::endl;
+        std::cout << "Journeys per query: " << String::prettyDouble(numberOfJourneys / static_cast<double>(numberOfQueries), 1) << std::endl;
+        std::cout << "Backward query time: " << String::msToString(backwardTime) << " (" << String::prettyDouble(backwardTime / numberOfQueries, 3) << "ms per query)" << std::endl;
+        if (compare) {
+            std::cout << "Bisection time: " << String::msToString(bisectionTime) << " (" << String::prettyDouble(bisectionTime / numberOfQueries, 3) << "ms per query, " << String::prettyDouble(numberOfBisectionSteps / static_cast<double>(numberOfQueries), 1) << " steps)" << std::endl;
+            std::cout << "Speedup: " << String::prettyDouble(bisectionTime / backwardTime, 2) << std::endl;
+            std::cout << "Queries with differing results: " << String::prettyInt(numberOfMismatches) << std::endl;
+        }
+        backwardQuery.debug(numberOfQueries);
+    }
+
+    inline static int getMinArrivalTime(const std::vector<TripBased::Journey>& journeys, const u_int32_t maxNumberOfUsedVehicles) noexcept {
+        int result = INFTY;
+        for (const TripBased::Journey& journey : journeys) {
+            if (journey.numberOfUsedVehicles > maxNumberOfUsedVehicles) break;
+            result = journey.arrivalTime;
+        }
+        return result;
+    }
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// RunOneToAllQueries //////////////////////////////////////////////////////////////////////
+class RunOneToAllQueries : public ParameterizedCommand {
+
+public:
+    RunOneToAllQueries(BasicShell& shell) :
+        ParameterizedCommand(shell, "runOneToAllQueries", "Evaluates ULTRA-Trip-Based one-to-all queries and compares them to one query per target vertex.") {
+        addParameter("Trip-Based file");
+        addParameter("CH file");
+        addParameter("Query file");
+        addParameter("Time budget", "infinity");
+        addParameter("Compared queries", "10");
+        addParameter("Debug", "false", {"true", "false"});
+    }
+
+    virtual void execute() noexcept {
+        const std::string tripBasedFile = getParameter("Trip-Based file");
+        const std::string chFile = getParameter("CH file");
+        const std::string queryFile = getParameter("Query file");
+        const int timeBudget = (getParameter("Time budget") == "infinity") ? INFTY : String::parseSeconds(getParameter("Time budget"));
+        const size_t comparedQueries = getParameter<size_t>("Compared queries");
+
+        std::vector<ULTRA::Query> queries;
+        IO::deserialize(queryFile, queries);
+        CH::CH ch(chFile);
+        TripBased::Data data(tripBasedFile);
+        const std::shared_ptr<const CH::BucketGraph> bucketGraph = CH::BucketGraph::FromCH(ch, chFile, data.numberOfStops());
+
+        const bool debug = getParameter<bool>("Debug");
+        TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+            using ReachedIndex = typename decltype(reachedIndex)::Type;
+            if (debug) {
+                run<ReachedIndex, TripBased::OneToAllQuery<ReachedIndex, true>>(data, ch, bucketGraph, queries, timeBudget, comparedQueries);
+            } else {
+                run<ReachedIndex, TripBased::OneToAllQuery<ReachedIndex, false>>(data, ch, bucketGraph, queries, timeBudget, comparedQueries);
+            }
+        });
+    }
+
+private:
+    template<typename REACHED_INDEX, typename ONE_TO_ALL_QUERY>
+    inline void run(const TripBased::Data& data, const CH::CH& ch, const std::shared_ptr<const CH::BucketGraph>& bucketGraph, const std::vector<ULTRA::Query>& queries, const int timeBudget, const size_t comparedQueries) noexcept {
+        ONE_TO_ALL_QUERY oneToAllQuery(data, ch, bucketGraph);
+        TripBased::Query<REACHED_INDEX, false> query(data, ch, bucketGraph);
+
+        std::cout << "Evaluating " << String::prettyInt(queries.size()) << " one-to-all queries..." << std::endl;
+        double oneToAllTime = 0;
+        double independentTime = 0;
+        size_t numberOfReachedVertices = 0;
+        size_t numberOfRounds = 0;
+        size_t numberOfComparedQueries = 0;
+        size_t numberOfMismatches = 0;
+        Timer timer;
+        for (size_t i = 0; i < queries.size(); i++) {
+            const ULTRA::Query& q = queries[i];
+            timer.restart();
+            oneToAllQuery.run(q.source, q.departureTime, timeBudget);
+            oneToAllTime += timer.elapsedMilliseconds();
+            numberOfRounds += oneToAllQuery.numberOfRounds();
+            for (const int arrivalTime : oneToAllQuery.getArrivalTimes()) {
+                if (arrivalTime < INFTY) numberOfReachedVertices++;
+            }
+            if (i >= comparedQueries) continue;
+
+            // Reference solution: One query per target vertex.
+            numberOfComparedQueries++;
+            timer.restart();
+            for (const Vertex target : ch.vertices()) {
+                query.run(q.source, q.departureTime, target);
+                int expectedArrivalTime = query.getEarliestArrivalTime();
+                if ((timeBudget < INFTY) && (expectedArrivalTime > q.departureTime + timeBudget)) expectedArrivalTime = INFTY;
+                if (expectedArrivalTime != oneToAllQuery.getArrivalTime(target)) numberOfMismatches++;
+            }
+            independentTime += timer.elapsedMilliseconds();
+        }
+
+        std::cout << "Reached vertices per query: " << String::prettyDouble(numberOfReachedVertices / static_cast<double>(queries.size()), 1) << " of " << String::prettyInt(ch.numVertices()) << std::endl;
+        std::cout << "Rounds per query: " << String::prettyDouble(numberOfRounds / static_cast<double>(queries.size()), 2) << std::endl;
+        std::cout << "One-to-all query time: " << String::msToString(oneToAllTime) << " (" << String::prettyDouble(oneToAllTime / queries.size(), 3) << "ms per query)" << std::endl;
+        if (numberOfComparedQueries > 0) {
+            std::cout << "Independent queries time: " << String::msToString(independentTime) << " (" << String::prettyDouble(independentTime / numberOfComparedQueries, 3) << "ms per source)" << std::endl;
+            std::cout << "Speedup: " << String::prettyDouble((independentTime / numberOfComparedQueries) / (oneToAllTime / queries.size()), 2) << std::endl;
+            std::cout << "Vertices with differing arrival times: " << String::prettyInt(numberOfMismatches) << std::endl;
+        }
+        oneToAllQuery.debug(queries.size());
+    }
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// ComputeTravelTimeMatrix //////////////////////////////////////////////////////////////////////
+class ComputeTravelTimeMatrix : public ParameterizedCommand {
+
+public:
+    ComputeTravelTimeMatrix(BasicShell& shell) :
+        ParameterizedCommand(shell, "computeTravelTimeMatrix", "Computes the travel times between all sources and targets (text files with one vertex per line) for every departure time, using one-to-all Trip-Based queries. Unreachable targets get the travel time -1.") {
+        addParameter("Trip-Based file");
+        addParameter("CH file");
+        addParameter("Source file");
+        addParameter("Target file");
+        addParameter("Departure times (comma separated)");
+        addParameter("Output file");
+        addParameter("Format", "binary", {"binary", "csv"});
+        addParameter("Time budget", "infinity");
+        addParameter("Number of threads", "max");
+        addParameter("Pin multiplier", "1");
+        addParameter("Rows per block", "1024");
+    }
+
+    virtual void execute() noexcept {
+        const std::string tripBasedFile = getParameter("Trip-Based file");
+        const std::string chFile = getParameter("CH file");
+        const std::string outputFile = getParameter("Output file");
+        const bool csv = (getParameter("Format") == "csv");
+        const int timeBudget = (getParameter("Time budget") == "infinity") ? INFTY : String::parseSeconds(getParameter("Time budget"));
+        const size_t numberOfThreads = (getParameter("Number of threads") == "max") ? numberOfCores() : getParameter<size_t>("Number of threads");
+        const ThreadPinning threadPinning(numberOfThreads, getParameter<size_t>("Pin multiplier"));
+        const size_t rowsPerBlock = std::max<size_t>(getParameter<size_t>("Rows per block"), 1);
+
+        CH::CH ch(chFile);
+        TripBased::Data data(tripBasedFile);
+        const std::vector<Vertex> sources = readVertices(getParameter("Source file"), ch.numVertices());
+        const std::vector<Vertex> targets = readVertices(getParameter("Target file"), ch.numVertices());
+        std::vector<int> departureTimes;
+        for (const std::string& departureTime : String::split(getParameter("Departure times (comma separated)"), ',')) {
+            departureTimes.emplace_back(String::parseSeconds(departureTime));
+        }
+        const std::shared_ptr<const CH::BucketGraph> bucketGraph = CH::BucketGraph::FromCH(ch, chFile, data.numberOfStops(), threadPinning);
+
+        TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+            using ReachedIndex = typename decltype(reachedIndex)::Type;
+            run<TripBased::OneToAllQuery<ReachedIndex, false>>(data, ch, bucketGraph, sources, targets, departureTimes, outputFile, csv, timeBudget, threadPinning, rowsPerBlock);
+        });
+    }
+
+private:
+    // The rows of the matrix (one per departure time and source, ordered by departure time first) are computed in blocks.
+    // The threads share the rows of a block, which is written to the output file before the next block is started, such
+    // that the memory consumption does not depend on the number of rows.
+    template<typename ONE_TO_ALL_QUERY>
+    inline void run(const TripBased::Data& data, const CH::CH& ch, const std::shared_ptr<const CH::BucketGraph>& bucketGraph, const std::vector<Vertex>& sources, const std::vector<Vertex>& targets, const std::vector<int>& departureTimes, const std::string& outputFile, const bool csv, const int timeBudget, const ThreadPinning& threadPinning, const size_t rowsPerBlock) noexcept {
+        const size_t numberOfRows = departureTimes.size() * sources.size();
+        std::cout << "Computing " << String::prettyInt(numberOfRows) << " x " << String::prettyInt(targets.size()) << " travel times with " << threadPinning.numberOfThreads << " threads..." << std::endl;
+        IO::OFStream output(outputFile, csv ? std::ios::out : (std::ios::out | std::ios::binary));
+        writeHeader(output, sources, targets, departureTimes, csv);
+
+        std::vector<int> block(std::min(rowsPerBlock, numberOfRows) * targets.size());
+        Progress progress(numberOfRows);
+        Timer timer;
+        double writeTime = 0;
+        omp_set_num_threads(threadPinning.numberOfThreads);
+        #pragma omp parallel
+        {
+            threadPinning.pinThread();
+            ONE_TO_ALL_QUERY query(data, ch, bucketGraph);
+
+            for (size_t blockBegin = 0; blockBegin < numberOfRows; blockBegin += rowsPerBlock) {
+                const size_t blockEnd = std::min(blockBegin + rowsPerBlock, numberOfRows);
+
+                #pragma omp for schedule(dynamic, 1)
+                for (size_t row = blockBegin; row < blockEnd; row++) {
+                    const int departureTime = departureTimes[row / sources.size()];
+                    query.run(sources[row % sources.size()], departureTime, timeBudget);
+                    int* travelTimes = block.data() + ((row - blockBegin) * targets.size());
+                    for (size_t i = 0; i < targets.size(); i++) {
+                        const int arrivalTime = query.getArrivalTime(targets[i]);
+                        travelTimes[i] = (arrivalTime >= INFTY) ? -1 : (arrivalTime - departureTime);
+                    }
+                    progress++;
+                }
+
+                #pragma omp single
+                {
+                    Timer writeTimer;
+                    writeRows(output, block, blockBegin, blockEnd, sources, targets.size(), departureTimes, csv);
+                    writeTime += writeTimer.elapsedMilliseconds();
+                }
+            }
+        }
+        progress.finished();
+        const double time = timer.elapsedMilliseconds();
+        std::cout << "Done in " << String::msToString(time) << " (" << String::prettyDouble(time / numberOfRows, 3) << "ms per row, writing: " << String::msToString(writeTime) << ")" << std::endl;
+        std::cout << "Block buffer: " << String::bytesToString(Vector::byteSize(block)) << std::endl;
+    }
+
+    // The binary format starts with the number of departure times, sources, and targets (32 bit each), followed by
+    // the departure times, the sources, the targets, and the travel times of all rows (32 bit each).
+    inline static void writeHeader(IO::OFStream& output, const std::vector<Vertex>& sources, const std::vector<Vertex>& targets, const std::vector<int>& departureTimes, const bool csv) noexcept {
+        if (csv) {
+            output << "DepTime,Source";
+            for (const Vertex target : targets) {
+                output << "," << target;
+            }
+            output << "\n";
+        } else {
+            const u_int32_t sizes[3] = {u_int32_t(departureTimes.size()), u_int32_t(sources.size()), u_int32_t(targets.size())};
+            output.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+            output.write(reinterpret_cast<const char*>(departureTimes.data()), departureTimes.size() * sizeof(int));
+            output.write(reinterpret_cast<const char*>(sources.data()), sources.size() * sizeof(Vertex));
+            output.write(reinterpret_cast<const char*>(targets.data()), targets.size() * sizeof(Vertex));
+        }
+    }
+
+    inline static void writeRows(IO::OFStream& output, const std::vector<int>& block, const size_t blockBegin, const size_t blockEnd, const std::vector<Vertex>& sources, const size_t numberOfTargets, const std::vector<int>& departureTimes, const bool csv) noexcept {
+        if (csv) {
+            for (size_t row = blockBegin; row < blockEnd; row++) {
+                output << departureTimes[row / sources.size()] << "," << sources[row % sources.size()];
+                const int* travelTimes = block.data() + ((row - blockBegin) * numberOfTargets);
+                for (size_t i = 0; i < numberOfTargets; i++) {
+                    output << "," << travelTimes[i];
+                }
+                output << "\n";
+            }
+        } else {
+            output.write(reinterpret_cast<const char*>(block.data()), (blockEnd - blockBegin) * numberOfTargets * sizeof(int));
+        }
+    }
+
+    inline static std::vector<Vertex> readVertices(const std::string& fileName, const size_t numberOfVertices) noexcept {
+        std::vector<Vertex> result;
+        IO::IFStream file(fileName);
+        size_t vertex;
+        while (file.getStream() >> vertex) {
+            Ensure(vertex < numberOfVertices, "The vertex " << vertex << " in " << fileName << " is not a vertex of the CH!");
+            result.emplace_back(vertex);
+        }
+        std::cout << "Read " << String::prettyInt(result.size()) << " vertices from " << fileName << std::endl;
+        return result;
+    }
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// BenchmarkReachedIndex //////////////////////////////////////////////////////////////////////
+class BenchmarkReachedIndex : public ParameterizedCommand {
+
+public:
+    BenchmarkReachedIndex(BasicShell& shell) :
+        ParameterizedCommand(shell, "benchmarkReachedIndex", "Measures the cost of resetting the reached index depending on the number of trips touched per query. Several networks can be given to compare how the cost grows with the network size."),
+        seed(42) {
+        addParameter("Trip-Based files (comma separated)");
+        addParameter("Number of resets", "1000");
+        addParameter("Seed", "42");
+    }
+
+    virtual void execute() noexcept {
+        const size_t numberOfResets = getParameter<size_t>("Number of resets");
+        seed = getParameter<int>("Seed");
+
+        std::cout << std::setw(12) << "Trips" << std::setw(12) << "Routes" << std::setw(8) << "Label" << std::setw(16) << "Touched trips" << std::setw(16) << "Copy" << std::setw(16) << "Timestamp" << std::endl;
+        for (const std::string& tripBasedFile : String::split(getParameter("Trip-Based files (comma separated)"), ',')) {
+            TripBased::Data data(tripBasedFile);
+            TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+                using Label = typename decltype(reachedIndex)::Type::Label;
+                run<TripBased::ReachedIndexImplementation<Label>, TripBased::ReachedIndexTimestampImplementation<Label>>(data, numberOfResets);
+            });
+        }
+    }
+
+private:
+    template<typename REACHED_INDEX, typename REACHED_INDEX_TIMESTAMP>
+    inline void run(const TripBased::Data& data, const size_t numberOfResets) noexcept {
+        for (size_t touchedTrips = 0; touchedTrips <= data.numberOfTrips(); touchedTrips = std::max<size_t>(touchedTrips * 10, 1)) {
+            const double copyTime = measure<REACHED_INDEX>(data, numberOfResets, touchedTrips);
+            const double timestampTime = measure<REACHED_INDEX_TIMESTAMP>(data, numberOfResets, touchedTrips);
+            std::cout << std::setw(12) << String::prettyInt(data.numberOfTrips()) << std::setw(12) << String::prettyInt(data.numberOfRoutes()) << std::setw(8) << (sizeof(typename REACHED_INDEX::Label) * 8) << std::setw(16) << String::prettyInt(touchedTrips) << std::setw(16) << (String::prettyDouble(copyTime, 3) + "µs") << std::setw(16) << (String::prettyDouble(timestampTime, 3) + "µs") << std::endl;
+        }
+    }
+
+    // The updates of each reset are drawn from a generator seeded with the reset index, such that both variants see the
+    // same updates while only the updates of a single reset are held in memory.
+    inline void generateUpdates(const TripBased::Data& data, const size_t reset, const size_t numberOfUpdates, std::vector<std::pair<TripId, StopIndex>>& updates) const noexcept {
+        std::mt19937 randomGenerator(seed + reset);
+        std::uniform_int_distribution<size_t> tripDistribution(0, data.numberOfTrips() - 1);
+        updates.clear();
+        for (size_t i = 0; i < numberOfUpdates; i++) {
+            const TripId trip(tripDistribution(randomGenerator));
+            std::uniform_int_distribution<size_t> indexDistribution(0, data.numberOfStopsInTrip(trip) - 1);
+            updates.emplace_back(trip, StopIndex(indexDistribution(randomGenerator)));
+        }
+    }
+
+    // Returns the time per reset (including the updates of the simulated query) in microseconds. Generating the updates is not measured.
+    template<typename REACHED_INDEX>
+    inline double measure(const TripBased::Data& data, const size_t numberOfResets, const size_t touchedTrips) const noexcept {
+        REACHED_INDEX reachedIndex(data);
+        std::vector<std::pair<TripId, StopIndex>> updates;
+        updates.reserve(touchedTrips);
+        size_t checksum = 0;
+        double time = 0;
+        Timer timer;
+        for (size_t i = 0; i < numberOfResets; i++) {
+            generateUpdates(data, i, touchedTrips, updates);
+            timer.restart();
+            reachedIndex.clear();
+            for (const auto& [trip, stopIndex] : updates) {
+                reachedIndex.update(trip, stopIndex);
+            }
+            if (touchedTrips > 0) checksum += reachedIndex(updates.front().first);
+            time += timer.elapsedMicroseconds();
+        }
+        if (checksum == size_t(-1)) std::cout << "Checksum: " << checksum << std::endl;
+        return time / numberOfResets;
+    }
+
+private:
+    int seed;
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// BenchmarkJourneyReconstruction //////////////////////////////////////////////////////////////////////
+class BenchmarkJourneyReconstruction : public ParameterizedCommand {
+
+public:
+    BenchmarkJourneyReconstruction(BasicShell& shell) :
+        ParameterizedCommand(shell, "benchmarkJourneyReconstruction", "Measures the overhead of parent tracking in the ULTRA-Trip-Based query and validates the reconstructed journeys.") {
+        addParameter("Trip-Based file");
+        addParameter("CH file");
+        addParameter("Query file");
+        addParameter("Number of printed queries", "0");
+    }
+
+    virtual void execute() noexcept {
+        const std::string tripBasedFile = getParameter("Trip-Based file");
+        const std::string chFile = getParameter("CH file");
+        const std::string queryFile = getParameter("Query file");
+        const size_t numberOfPrintedQueries = getParameter<size_t>("Number of printed queries");
+
+        std::vector<ULTRA::Query> queries;
+        IO::deserialize(queryFile, queries);
+        CH::CH ch(chFile);
+        TripBased::Data data(tripBasedFile);
+
+        TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+            using ReachedIndex = typename decltype(reachedIndex)::Type;
+            run<ReachedIndex>(data, ch, queries, numberOfPrintedQueries);
+        });
+    }
+
+private:
+    template<typename REACHED_INDEX>
+    inline void run(const TripBased::Data& data, const CH::CH& ch, const std::vector<ULTRA::Query>& queries, const size_t numberOfPrintedQueries) noexcept {
+        TripBased::Query<REACHED_INDEX, false, false> query(data, ch);
+        TripBased::Query<REACHED_INDEX, false, true> trackingQuery(data, ch);
+
+        Timer timer;
+        for (const ULTRA::Query& q : queries) {
+            query.run(q.source, q.departureTime, q.target);
+        }
+        const double queryTime = timer.elapsedMilliseconds();
+
+        timer.restart();
+        for (const ULTRA::Query& q : queries) {
+            trackingQuery.run(q.source, q.departureTime, q.target);
+        }
+        const double trackingTime = timer.elapsedMilliseconds();
+
+        double reconstructionTime = 0;
+        size_t numberOfJourneys = 0;
+        size_t numberOfInvalidJourneys = 0;
+        for (size_t i = 0; i < queries.size(); i++) {
+            const ULTRA::Query& q = queries[i];
+            query.run(q.source, q.departureTime, q.target);
+            trackingQuery.run(q.source, q.departureTime, q.target);
+            timer.restart();
+            const std::vector<TripBased::Journey> journeys = trackingQuery.getJourneys();
+            reconstructionTime += timer.elapsedMilliseconds();
+            const std::vector<TripBased::Journey> expectedJourneys = query.getJourneys();
+            numberOfJourneys += journeys.size();
+            if (journeys.size() != expectedJourneys.size()) numberOfInvalidJourneys += journeys.size();
+            for (size_t j = 0; j < std::min(journeys.size(), expectedJourneys.size()); j++) {
+                if (!isValid(journeys[j], q) || journeys[j].arrivalTime != expectedJourneys[j].arrivalTime || journeys[j].numberOfUsedVehicles != expectedJourneys[j].numberOfUsedVehicles) {
+                    numberOfInvalidJourneys++;
+                }
+            }
+            if (i < numberOfPrintedQueries) {
+                std::cout << "Query from " << q.source << " to " << q.target << " at " << String::secToTime(q.departureTime) << ":" << std::endl;
+                for (const TripBased::Journey& journey : journeys) {
+                    std::cout << "  " << journey << std::endl;
+                }
+            }
+        }
+
+        std::cout << "Query without parent tracking: " << String::prettyDouble(queryTime / queries.size(), 3) << "ms per query" << std::endl;
+        std::cout << "Query with parent tracking: " << String::prettyDouble(trackingTime / queries.size(), 3) << "ms per query (" << String::percent((trackingTime / queryTime) - 1) << " overhead)" << std::endl;
+        std::cout << "Journey reconstruction: " << String::prettyDouble(reconstructionTime / queries.size(), 3) << "ms per query" << std::endl;
+        std::cout << "Journeys: " << String::prettyInt(numberOfJourneys) << ", invalid: " << String::prettyInt(numberOfInvalidJourneys) << std::endl;
+    }
+
+    // The legs must form a connected sequence from source to target that respects the time and uses the right number of trips.
+    inline static bool isValid(const TripBased::Journey& journey, const ULTRA::Query& query) noexcept {
+        if (journey.legs.empty()) return false;
+        if (journey.legs.front().from != query.source || journey.legs.back().to != query.target) return false;
+        if (journey.legs.front().departureTime < query.departureTime || journey.legs.back().arrivalTime != journey.arrivalTime) return false;
+        size_t numberOfTrips = 0;
+        for (size_t i = 0; i < journey.legs.size(); i++) {
+            const TripBased::JourneyLeg& leg = journey.legs[i];
+            if (leg.departureTime > leg.arrivalTime) return false;
+            if (leg.usesTrip()) numberOfTrips++;
+            if (i == 0) continue;
+            if (journey.legs[i - 1].to != leg.from || journey.legs[i - 1].arrivalTime > leg.departureTime) return false;
+        }
+        return numberOfTrips == journey.numberOfUsedVehicles;
+    }
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// BenchmarkLowerBoundPruning //////////////////////////////////////////////////////////////////////
+class BenchmarkLowerBoundPruning : public ParameterizedCommand {
+
+public:
+    BenchmarkLowerBoundPruning(BasicShell& shell) :
+        ParameterizedCommand(shell, "benchmarkLowerBoundPruning", "Compares the ULTRA-Trip-Based query with and without lower bound target pruning, grouped by the Geo-Rank of the queries (see generateGeoRankQueries).") {
+        addParameter("Trip-Based file");
+        addParameter("CH file");
+        addParameter("Query file");
+    }
+
+    virtual void execute() noexcept {
+        const std::string tripBasedFile = getParameter("Trip-Based file");
+        const std::string chFile = getParameter("CH file");
+        const std::string queryFile = getParameter("Query file");
+
+        std::vector<ULTRA::Query> queries;
+        IO::deserialize(queryFile, queries);
+        CH::CH ch(chFile);
+        TripBased::Data data(tripBasedFile);
+        const std::shared_ptr<const CH::BucketGraph> bucketGraph = CH::BucketGraph::FromCH(ch, chFile, data.numberOfStops());
+
+        TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+            using ReachedIndex = typename decltype(reachedIndex)::Type;
+            run<ReachedIndex>(data, ch, bucketGraph, queries);
+        });
+    }
+
+private:
+    template<typename REACHED_INDEX>
+    inline void run(const TripBased::Data& data, const CH::CH& ch, const std::shared_ptr<const CH::BucketGraph>& bucketGraph, const std::vector<ULTRA::Query>& queries) noexcept {
+        ULTRA::compareQueriesByGeoRank<TripBased::Query<REACHED_INDEX>, TripBased::Query<REACHED_INDEX, false, false, true>>(data, ch, bucketGraph, queries, "Query", "Pruned");
+    }
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// BenchmarkArcFlags //////////////////////////////////////////////////////////////////////
+class BenchmarkArcFlags : public ParameterizedCommand {
+
+public:
+    BenchmarkArcFlags(BasicShell& shell) :
+        ParameterizedCommand(shell, "benchmarkArcFlags", "Compares the ULTRA-Trip-Based query with and without arc flags (see computeArcFlags), grouped by the Geo-Rank of the queries (see generateGeoRankQueries).") {
+        addParameter("Trip-Based file");
+        addParameter("CH file");
+        addParameter("Query file");
+    }
+
+    virtual void execute() noexcept {
+        const std::string tripBasedFile = getParameter("Trip-Based file");
+        const std::string chFile = getParameter("CH file");
+        const std::string queryFile = getParameter("Query file");
+
+        std::vector<ULTRA::Query> queries;
+        IO::deserialize(queryFile, queries);
+        CH::CH ch(chFile);
+        TripBased::Data data(tripBasedFile);
+        Ensure(data.hasArcFlags(), "The Trip-Based data " << tripBasedFile << " has no arc flags (see computeArcFlags)!");
+        const std::shared_ptr<const CH::BucketGraph> bucketGraph = CH::BucketGraph::FromCH(ch, chFile, data.numberOfStops());
+
+        TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+            using ReachedIndex = typename decltype(reachedIndex)::Type;
+            run<ReachedIndex>(data, ch, bucketGraph, queries);
+        });
+    }
+
+private:
+    template<typename REACHED_INDEX>
+    inline void run(const TripBased::Data& data, const CH::CH& ch, const std::shared_ptr<const CH::BucketGraph>& bucketGraph, const std::vector<ULTRA::Query>& queries) noexcept {
+        ULTRA::compareQueriesByGeoRank<TripBased::Query<REACHED_INDEX>, TripBased::Query<REACHED_INDEX, false, false, false, true>>(data, ch, bucketGraph, queries, "Query", "Flags");
+    }
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// BenchmarkLoading //////////////////////////////////////////////////////////////////////
+class BenchmarkLoading : public ParameterizedCommand {
+
+public:
+    BenchmarkLoading(BasicShell& shell) :
+        ParameterizedCommand(shell, "benchmarkLoading", "Measures the time and resident memory needed to load a Trip-Based network and to answer the first queries on it.") {
+        addParameter("Trip-Based file");
+        addParameter("CH file");
+        addParameter("Query file");
+    }
+
+    virtual void execute() noexcept {
+        const std::string tripBasedFile = getParameter("Trip-Based file");
+        const std::string chFile = getParameter("CH file");
+        const std::string queryFile = getParameter("Query file");
+
+        std::vector<ULTRA::Query> queries;
+        IO::deserialize(queryFile, queries);
+        CH::CH ch(chFile);
+
+        const size_t initialResidentMemory = residentMemory();
+        Timer timer;
+        TripBased::Data data(tripBasedFile);
+        const double loadTime = timer.elapsedMilliseconds();
+        const size_t loadedResidentMemory = residentMemory();
+        std::cout << "Stop events are " << (data.raptorData.stopEvents.isMapped() ? "memory mapped" : "loaded into memory") << std::endl;
+
+        TripBased::chooseReachedIndex<TripBased::ReachedIndexImplementation>(data, [&](const auto reachedIndex) {
+            using ReachedIndex = typename decltype(reachedIndex)::Type;
+            timer.restart();
+            TripBased::Query<ReachedIndex, false> query(data, ch, CH::BucketGraph::FromCH(ch, chFile, data.numberOfStops(), ThreadPinning(1, 1), false));
+            const double initializationTime = timer.elapsedMilliseconds();
+            timer.restart();
+            for (const ULTRA::Query& q : queries) {
+                query.run(q.source, q.departureTime, q.target);
+            }
+            const double queryTime = timer.elapsedMilliseconds();
+            std::cout << "Loading time: " << String::msToString(loadTime) << std::endl;
+            std::cout << "Query initialization time: " << String::msToString(initializationTime) << std::endl;
+            std::cout << "Time for " << String::prettyInt(queries.size()) << " queries: " << String::msToString(queryTime) << std::endl;
+        });
+        // Absolute values, since freed memory of earlier shell commands may be reused.
+        std::cout << "Resident memory before loading: " << String::bytesToString(initialResidentMemory) << std::endl;
+        std::cout << "Resident memory after loading: " << String::bytesToString(loadedResidentMemory) << std::endl;
+        std::cout << "Resident memory after queries: " << String::bytesToString(residentMemory()) << std::endl;
+    }
+
+private:
+    inline static size_t residentMemory() noexcept {
+        std::ifstream statm("/proc/self/statm");
+        size_t totalPages = 0;
+        size_t residentPages = 0;
+        statm >> totalPages >> residentPages;
+        return residentPages * sysconf(_SC_PAGESIZE);
+    }
+
 };
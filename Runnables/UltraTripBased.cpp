@@ -34,12 +34,30 @@ int main(int argc, char** argv) {
     ::Shell::Shell shell;
     new BuildCH(shell);
     new CoreCH(shell);
+    new BuildBucketGraph(shell);
     new ComputeStopToStopShortcuts(shell);
     new RAPTORToTripBased(shell);
     new ComputeEventToEventShortcuts(shell);
+    new ComputeStopToStopShortcutShard(shell);
+    new MergeStopToStopShortcuts(shell);
+    new ComputeEventToEventShortcutShard(shell);
+    new MergeEventToEventShortcuts(shell);
+    new RepairEventToEventShortcuts(shell);
+    new EstimatePreprocessing(shell);
+    new MakeTripBasedMappable(shell);
+    new ComputeArcFlags(shell);
     new GenerateUltraQueries(shell);
     new GenerateGeoRankQueries(shell);
     new RunUltraQueries(shell);
+    new RunProfileQueries(shell);
+    new RunArriveByQueries(shell);
+    new RunOneToAllQueries(shell);
+    new ComputeTravelTimeMatrix(shell);
+    new BenchmarkReachedIndex(shell);
+    new BenchmarkJourneyReconstruction(shell);
+    new BenchmarkLowerBoundPruning(shell);
+    new BenchmarkArcFlags(shell);
+    new BenchmarkLoading(shell);
     shell.run();
     return 0;
 }